@@ -0,0 +1,23 @@
+######################################################################
+# Benchmarks of capture and encode pipeline, built by `make benchmark` of main project.
+######################################################################
+
+TEMPLATE = app
+TARGET = deepin-screen-recorder-benchmark
+INCLUDEPATH += . ../src
+
+CONFIG += link_pkgconfig
+CONFIG += c++11
+CONFIG += console
+CONFIG -= app_bundle
+PKGCONFIG += xcb xcb-util xcb-shm xcb-damage xcb-xfixes xcb-randr xcb-composite
+
+# Input
+HEADERS += micro_benchmark.h record_benchmark.h ../src/window_manager.h ../src/screen_capture.h ../src/output_capture.h ../src/frame_pool.h ../src/spsc_queue.h ../src/color_convert.h ../src/record_pipeline.h ../src/frame_scheduler.h ../src/frame_hash.h ../src/color_quantizer.h ../src/lzw_encoder.h ../src/cursor_tracker.h ../src/frame_scaler.h
+SOURCES += main.cpp micro_benchmark.cpp record_benchmark.cpp ../src/window_manager.cpp ../src/screen_capture.cpp ../src/output_capture.cpp ../src/frame_pool.cpp ../src/color_convert.cpp ../src/record_pipeline.cpp ../src/frame_scheduler.cpp ../src/frame_hash.cpp ../src/color_quantizer.cpp ../src/lzw_encoder.cpp ../src/cursor_tracker.cpp ../src/frame_scaler.cpp
+
+QT += core
+QT += gui
+QT += x11extras
+
+QMAKE_CXXFLAGS += -g
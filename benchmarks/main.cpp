@@ -0,0 +1,65 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+#include <stdio.h>
+#include "micro_benchmark.h"
+#include "record_benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks of deepin-screen-recorder capture and encode pipeline.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("mode", "micro (default) or record.");
+
+    QCommandLineOption secondsOption("seconds", "Record benchmark duration in seconds.", "seconds", "10");
+    QCommandLineOption frameRateOption("fps", "Record benchmark frame rate.", "fps", "25");
+    QCommandLineOption sizeOption("size", "Xvfb screen size.", "WxH", "1920x1080");
+    QCommandLineOption damageOption("damage", "Capture with XDamage.");
+    QCommandLineOption displayOption("no-xvfb", "Record current $DISPLAY instead of start Xvfb.");
+    parser.addOption(secondsOption);
+    parser.addOption(frameRateOption);
+    parser.addOption(sizeOption);
+    parser.addOption(damageOption);
+    parser.addOption(displayOption);
+    parser.process(app);
+
+    QString mode = parser.positionalArguments().isEmpty() ? "micro" : parser.positionalArguments().first();
+    if (mode == "micro") {
+        runMicroBenchmarks();
+        return 0;
+    } else if (mode == "record") {
+        return runRecordBenchmark(parser.value(secondsOption).toInt(), parser.value(frameRateOption).toInt(),
+                                  parser.value(sizeOption), parser.isSet(damageOption), !parser.isSet(displayOption));
+    } else if (mode == "animate") {
+        return runSceneAnimation();
+    }
+
+    parser.showHelp(1);
+    return 1;
+}
@@ -0,0 +1,155 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include <stdio.h>
+#include <stdlib.h>
+#include "micro_benchmark.h"
+#include "color_convert.h"
+#include "frame_scaler.h"
+#include "frame_hash.h"
+#include "color_quantizer.h"
+#include "lzw_encoder.h"
+
+static const qint64 MIN_DURATION = 500000000LL;
+static const int MIN_RUNS = 3;
+
+// Average milliseconds of one run, run at least MIN_DURATION and MIN_RUNS times after one warm up run.
+template <typename Function>
+static double measure(Function function)
+{
+    function();
+
+    QElapsedTimer timer;
+    timer.start();
+    int runs = 0;
+    do {
+        function();
+        runs++;
+    } while (timer.nsecsElapsed() < MIN_DURATION || runs < MIN_RUNS);
+
+    return timer.nsecsElapsed() / 1000000.0 / runs;
+}
+
+static void printResult(const char *name, int width, int height, double milliseconds)
+{
+    printf("%-28s %5dx%-5d %9.3f ms %9.1f Mpixel/s\n", name, width, height, milliseconds, width * height / milliseconds / 1000.0);
+    fflush(stdout);
+}
+
+// Screen like content: flat blocks, gradients and some noise, so quantizer and LZW see realistic color number.
+static void fillFrame(unsigned char *frame, int width, int height)
+{
+    srand(1);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char *pixel = frame + (y * width + x) * 4;
+            bool isBlock = ((x / 64) + (y / 64)) % 3 == 0;
+            pixel[0] = isBlock ? 240 : x * 255 / width;
+            pixel[1] = isBlock ? 240 : y * 255 / height;
+            pixel[2] = isBlock ? 240 : (rand() & 0x3F) + 96;
+            pixel[3] = 0xFF;
+        }
+    }
+}
+
+static void benchmarkSize(int width, int height)
+{
+    int stride = width * 4;
+    QVector<unsigned char> frame(stride * height);
+    fillFrame(frame.data(), width, height);
+
+    // Color convert, every implementation that CPU support.
+    QVector<unsigned char> yuv(width * height * 3 / 2);
+    unsigned char *y = yuv.data();
+    unsigned char *u = y + width * height;
+    unsigned char *v = u + width * height / 4;
+    int defaultImplementation = ColorConvert::getImplementation();
+    for (int i = ColorConvert::IMPLEMENTATION_SCALAR; i <= ColorConvert::IMPLEMENTATION_NEON; i++) {
+        if (!ColorConvert::isSupported(i)) {
+            continue;
+        }
+        ColorConvert::setImplementation(i);
+        double time = measure([&]() {
+                ColorConvert::bgraToI420(frame.constData(), stride, width, height, y, width, u, width / 2, v, width / 2);
+            });
+        printResult(QString("bgraToI420 (%1)").arg(ColorConvert::getImplementationName(i)).toLatin1().constData(), width, height, time);
+    }
+    ColorConvert::setImplementation(defaultImplementation);
+
+    // Scale to half size (box filter) and to 2/3 size (bilinear filter).
+    QVector<unsigned char> scaled(stride * height);
+    FrameScaler halfScaler;
+    halfScaler.init(width, height, width / 2, height / 2);
+    printResult("scale 50%", width, height, measure([&]() {
+                halfScaler.scale(frame.constData(), stride, scaled.data(), width / 2 * 4);
+            }));
+
+    int bilinearWidth = width * 2 / 3 & ~1;
+    int bilinearHeight = height * 2 / 3 & ~1;
+    FrameScaler bilinearScaler;
+    bilinearScaler.init(width, height, bilinearWidth, bilinearHeight);
+    printResult("scale 67%", width, height, measure([&]() {
+                bilinearScaler.scale(frame.constData(), stride, scaled.data(), bilinearWidth * 4);
+            }));
+
+    // Row hash, runtime picked implementation and scalar reference.
+    QVector<quint64> hashes(height);
+    printResult(QString("hashRows (%1)").arg(FrameHash::getImplementationName()).toLatin1().constData(), width, height, measure([&]() {
+                FrameHash::hashRows(frame.constData(), stride, stride, height, hashes.data());
+            }));
+    printResult("hashRows (scalar)", width, height, measure([&]() {
+                for (int row = 0; row < height; row++) {
+                    hashes[row] = FrameHash::hashRowScalar(frame.constData() + row * stride, stride);
+                }
+            }));
+
+    // GIF frame: palette, index mapping and LZW.
+    ColorQuantizer quantizer;
+    QVector<unsigned char> indexes(width * height);
+    printResult("gif buildPalette", width, height, measure([&]() {
+                quantizer.buildPalette(frame.constData(), stride, width, height, 256, false);
+            }));
+    printResult("gif mapPixels", width, height, measure([&]() {
+                quantizer.mapPixels(frame.constData(), stride, width, height, -1, indexes.data());
+            }));
+
+    LzwEncoder encoder;
+    QByteArray output;
+    printResult("gif lzw", width, height, measure([&]() {
+                output.clear();
+                encoder.encode(indexes.constData(), indexes.size(), 8, output);
+            }));
+    printf("%-28s %5dx%-5d %9d bytes\n", "gif lzw output", width, height, output.size());
+    printf("\n");
+}
+
+void runMicroBenchmarks()
+{
+    benchmarkSize(1280, 720);
+    benchmarkSize(1920, 1080);
+    benchmarkSize(3840, 2160);
+}
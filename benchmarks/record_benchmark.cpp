@@ -0,0 +1,244 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <xcb/xcb.h>
+#include <xcb/xcb_aux.h>
+#include "record_benchmark.h"
+#include "record_pipeline.h"
+#include "window_manager.h"
+
+static const char *XVFB_DISPLAY = ":99";
+static const int XVFB_START_TIMEOUT = 5000;
+static const int ANIMATION_START_TIME = 500;
+static const int ANIMATION_FRAME_RATE = 60;
+static const int ANIMATION_RECT_NUM = 16;
+static const qint64 FRAME_POOL_BUDGET = 256LL * 1024LL * 1024LL;
+
+// Stop pipeline after benchmark duration, main thread keep draining frames until pipeline finished.
+class StopTimer : public QThread
+{
+public:
+    StopTimer(RecordPipeline *p, int ms)
+    {
+        pipeline = p;
+        milliseconds = ms;
+    }
+
+protected:
+    void run()
+    {
+        msleep(milliseconds);
+        pipeline->stop();
+    }
+
+private:
+    RecordPipeline *pipeline;
+    int milliseconds;
+};
+
+// User and system CPU time (microseconds) of this process.
+static qint64 getCpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static bool startXvfb(QProcess &xvfb, QString screenSize)
+{
+    xvfb.start("Xvfb", QStringList() << XVFB_DISPLAY << "-screen" << "0" << screenSize + "x24" << "-nolisten" << "tcp");
+    if (!xvfb.waitForStarted()) {
+        printf("Start Xvfb failed, is it installed?\n");
+        return false;
+    }
+
+    // Xvfb is ready when it accept connection.
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        xcb_connection_t *conn = xcb_connect(XVFB_DISPLAY, NULL);
+        bool isConnected = !xcb_connection_has_error(conn);
+        xcb_disconnect(conn);
+        if (isConnected) {
+            break;
+        }
+
+        if (timer.elapsed() > XVFB_START_TIMEOUT || xvfb.state() != QProcess::Running) {
+            printf("Xvfb is not ready on %s\n", XVFB_DISPLAY);
+            return false;
+        }
+        QThread::msleep(50);
+    }
+
+    // Child processes and WindowManager connect to $DISPLAY.
+    qputenv("DISPLAY", XVFB_DISPLAY);
+
+    return true;
+}
+
+int runRecordBenchmark(int seconds, int frameRate, QString screenSize, bool useDamage, bool useXvfb)
+{
+    QProcess xvfb;
+    if (useXvfb && !startXvfb(xvfb, screenSize)) {
+        return 1;
+    }
+
+    // Animation run in child process, so its CPU time is not counted.
+    QProcess animation;
+    animation.setProcessChannelMode(QProcess::ForwardedChannels);
+    animation.start(QCoreApplication::applicationFilePath(), QStringList() << "animate");
+    animation.waitForStarted();
+    QThread::msleep(ANIMATION_START_TIME);
+
+    int result = 0;
+    {
+        WindowManager windowManager;
+        WindowRect rootRect = windowManager.getRootWindowRect();
+        int width = rootRect.width & ~1;
+        int height = rootRect.height & ~1;
+
+        RecordPipeline pipeline;
+        if (!pipeline.init(0, 0, width, height, useDamage, frameRate,
+                           FRAME_POOL_BUDGET, false, RecordPipeline::OUTPUT_FORMAT_I420, width, height)) {
+            printf("Init record pipeline failed\n");
+            result = 1;
+        } else {
+            qint64 cpuTime = getCpuTime();
+            QElapsedTimer timer;
+            StopTimer stopTimer(&pipeline, seconds * 1000);
+
+            pipeline.start();
+            timer.start();
+            stopTimer.start();
+
+            // Frames are consumed like encoder, but not encoded, only capture and convert stages are measured.
+            qint64 frameNum = 0;
+            PipelineFrame frame;
+            while (pipeline.popFrame(frame)) {
+                pipeline.recycleFrame(frame.index);
+                frameNum++;
+            }
+            pipeline.wait();
+            stopTimer.wait();
+            pipeline.finishEncode(frameNum);
+
+            double duration = timer.nsecsElapsed() / 1000000000.0;
+            cpuTime = getCpuTime() - cpuTime;
+            qint64 capturedFrames = std::max(pipeline.getCapturedFrames(), 1LL);
+
+            printf("Record %dx%d at %d fps for %.1f s, %s capture\n", width, height, frameRate, duration, useDamage ? "damage" : "full");
+            printf("Sustained frame rate: %.2f fps\n", frameNum / duration);
+            printf("Captured frames: %lld, missed deadlines: %lld, dropped: %lld, duplicate: %lld\n",
+                   pipeline.getCapturedFrames(), pipeline.getMissedFrames(), pipeline.getDroppedFrames(), pipeline.getDuplicateFrames());
+            printf("CPU time per captured frame: %.2f ms (%.0f%% of one core)\n",
+                   cpuTime / 1000.0 / capturedFrames, cpuTime / 10000.0 / duration);
+            fflush(stdout);
+
+            pipeline.printStatistics();
+        }
+    }
+
+    animation.kill();
+    animation.waitForFinished();
+
+    if (useXvfb) {
+        xvfb.terminate();
+        xvfb.waitForFinished();
+    }
+
+    return result;
+}
+
+// Position of rectangle that bounce between 0 and range.
+static int bounce(qint64 position, int range)
+{
+    int offset = position % (range * 2);
+    return offset <= range ? offset : range * 2 - offset;
+}
+
+int runSceneAnimation()
+{
+    int screenNum;
+    xcb_connection_t *conn = xcb_connect(NULL, &screenNum);
+    if (xcb_connection_has_error(conn)) {
+        printf("Connect X server failed\n");
+        return 1;
+    }
+    xcb_screen_t *screen = xcb_aux_get_screen(conn, screenNum);
+    int width = screen->width_in_pixels;
+    int height = screen->height_in_pixels;
+
+    // Override redirect window cover whole screen without window manager.
+    xcb_window_t window = xcb_generate_id(conn);
+    uint32_t windowValues[] = { screen->black_pixel, 1 };
+    xcb_create_window(conn, XCB_COPY_FROM_PARENT, window, screen->root, 0, 0, width, height, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT, windowValues);
+    xcb_map_window(conn, window);
+
+    xcb_gcontext_t gc = xcb_generate_id(conn);
+    xcb_create_gc(conn, gc, window, 0, NULL);
+
+    // Rectangles move every frame and only change part of screen, like normal desktop usage.
+    int size = std::max(height / 8, 1);
+    QVector<xcb_rectangle_t> rects(ANIMATION_RECT_NUM);
+    QVector<xcb_rectangle_t> lastRects;
+    for (qint64 frame = 0; !xcb_connection_has_error(conn); frame++) {
+        if (!lastRects.isEmpty()) {
+            uint32_t black = screen->black_pixel;
+            xcb_change_gc(conn, gc, XCB_GC_FOREGROUND, &black);
+            xcb_poly_fill_rectangle(conn, window, gc, lastRects.size(), lastRects.constData());
+        }
+
+        for (int i = 0; i < ANIMATION_RECT_NUM; i++) {
+            rects[i].x = bounce(frame * (4 + i) + i * 97, std::max(width - size, 1));
+            rects[i].y = bounce(frame * (3 + i % 5) + i * 61, std::max(height - size, 1));
+            rects[i].width = size;
+            rects[i].height = size;
+
+            uint32_t color = (0x40 + i * 12) << (i % 3 * 8) | 0x202020;
+            xcb_change_gc(conn, gc, XCB_GC_FOREGROUND, &color);
+            xcb_poly_fill_rectangle(conn, window, gc, 1, &rects[i]);
+        }
+        xcb_flush(conn);
+        lastRects = rects;
+
+        usleep(1000000 / ANIMATION_FRAME_RATE);
+    }
+
+    xcb_disconnect(conn);
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDBENCHMARK_H
+#define RECORDBENCHMARK_H
+
+#include <QString>
+
+// Record synthetic animated scene with record pipeline, report sustained frame rate, dropped frames and CPU time per frame.
+// Xvfb is started with given screen size if useXvfb is true, otherwise current $DISPLAY is recorded.
+int runRecordBenchmark(int seconds, int frameRate, QString screenSize, bool useDamage, bool useXvfb);
+
+// Draw moving rectangles on full screen window until killed, run in separate process so it don't count in CPU time.
+int runSceneAnimation();
+
+#endif
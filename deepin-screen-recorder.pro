@@ -8,12 +8,12 @@ INCLUDEPATH += .
 
 CONFIG += link_pkgconfig
 CONFIG += c++11 
-PKGCONFIG += xcb xcb-util dtkwidget dtkbase
+PKGCONFIG += xcb xcb-util xcb-shm xcb-damage xcb-xfixes xcb-randr xcb-composite dtkwidget dtkbase
 RESOURCES = deepin-screen-recorder.qrc
 
 # Input
-HEADERS += src/window_manager.h src/main_window.h src/record_process.h src/settings.h src/utils.h src/record_button.h src/record_option_panel.h src/countdown_tooltip.h src/constant.h src/event_monitor.h src/start_tooltip.h src/button_feedback.h
-SOURCES += src/main.cpp src/window_manager.cpp src/main_window.cpp src/record_process.cpp src/settings.cpp src/utils.cpp src/record_button.cpp src/record_option_panel.cpp src/countdown_tooltip.cpp src/constant.cpp src/event_monitor.cpp src/start_tooltip.cpp src/button_feedback.cpp
+HEADERS += src/window_manager.h src/main_window.h src/record_process.h src/settings.h src/utils.h src/record_button.h src/record_option_panel.h src/countdown_tooltip.h src/constant.h src/event_monitor.h src/start_tooltip.h src/button_feedback.h src/screen_capture.h src/frame_pool.h src/spsc_queue.h src/color_convert.h src/record_pipeline.h src/frame_scheduler.h src/matroska_writer.h src/frame_hash.h src/color_quantizer.h src/lzw_encoder.h src/gif_writer.h src/gif_encoder.h src/replay_buffer.h src/cursor_tracker.h src/output_capture.h src/frame_scaler.h src/window_index.h
+SOURCES += src/main.cpp src/window_manager.cpp src/main_window.cpp src/record_process.cpp src/settings.cpp src/utils.cpp src/record_button.cpp src/record_option_panel.cpp src/countdown_tooltip.cpp src/constant.cpp src/event_monitor.cpp src/start_tooltip.cpp src/button_feedback.cpp src/screen_capture.cpp src/frame_pool.cpp src/color_convert.cpp src/record_pipeline.cpp src/frame_scheduler.cpp src/matroska_writer.cpp src/frame_hash.cpp src/color_quantizer.cpp src/lzw_encoder.cpp src/gif_writer.cpp src/gif_encoder.cpp src/replay_buffer.cpp src/cursor_tracker.cpp src/output_capture.cpp src/frame_scaler.cpp src/window_index.cpp
 
 QT += core
 QT += widgets
@@ -40,6 +40,15 @@ desktop.files = deepin-screen-recorder.desktop
 
 INSTALLS += target icon desktop
 
+# Benchmarks are not part of default build.
+# `make benchmark` run micro benchmarks, `make benchmark_record` record synthetic scene on Xvfb.
+benchmark_build.commands = $(MKDIR) benchmarks && cd benchmarks && $(QMAKE) $$PWD/benchmarks/benchmarks.pro && $(MAKE)
+benchmark.depends = benchmark_build
+benchmark.commands = benchmarks/deepin-screen-recorder-benchmark micro
+benchmark_record.depends = benchmark_build
+benchmark_record.commands = benchmarks/deepin-screen-recorder-benchmark record
+QMAKE_EXTRA_TARGETS += benchmark_build benchmark benchmark_record
+
 isEmpty(TRANSLATIONS) {
      include(translations.pri)
 
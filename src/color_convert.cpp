@@ -0,0 +1,503 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QVector>
+#include <string.h>
+#include "color_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLOR_CONVERT_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define COLOR_CONVERT_NEON
+#endif
+
+const int ColorConvert::IMPLEMENTATION_SCALAR = 0;
+const int ColorConvert::IMPLEMENTATION_SSE2 = 1;
+const int ColorConvert::IMPLEMENTATION_AVX2 = 2;
+const int ColorConvert::IMPLEMENTATION_NEON = 3;
+
+// Convert two rows, write Y of both rows and one chroma row.
+// Chroma is written to u and v (I420) or interleaved to uv if uv is not NULL (NV12).
+typedef void (*ConvertRowsFunc)(const unsigned char *row0, const unsigned char *row1, int width,
+                                unsigned char *y0, unsigned char *y1,
+                                unsigned char *u, unsigned char *v, unsigned char *uv);
+
+static inline unsigned char rgbToY(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline unsigned char rgbToU(int r, int g, int b)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline unsigned char rgbToV(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// Scalar version is reference of other implementations, and handle pixels left by SIMD loop.
+static void convertRowsScalar(const unsigned char *row0, const unsigned char *row1, int width,
+                              unsigned char *y0, unsigned char *y1,
+                              unsigned char *u, unsigned char *v, unsigned char *uv)
+{
+    for (int x = 0; x < width; x += 2) {
+        const unsigned char *p00 = row0 + x * 4;
+        const unsigned char *p01 = p00 + 4;
+        const unsigned char *p10 = row1 + x * 4;
+        const unsigned char *p11 = p10 + 4;
+
+        y0[x] = rgbToY(p00[2], p00[1], p00[0]);
+        y0[x + 1] = rgbToY(p01[2], p01[1], p01[0]);
+        y1[x] = rgbToY(p10[2], p10[1], p10[0]);
+        y1[x + 1] = rgbToY(p11[2], p11[1], p11[0]);
+
+        // Chroma use average color of 2x2 block.
+        int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+        int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+        int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+        if (uv) {
+            uv[x] = rgbToU(r, g, b);
+            uv[x + 1] = rgbToV(r, g, b);
+        } else {
+            u[x / 2] = rgbToU(r, g, b);
+            v[x / 2] = rgbToV(r, g, b);
+        }
+    }
+}
+
+// SIMD versions compute in 16 bits lanes:
+// 66 * 255 + 129 * 255 + 25 * 255 + 128 still fit in unsigned 16 bits,
+// and chroma formula result fit in signed 16 bits, so they match scalar version exactly.
+#ifdef COLOR_CONVERT_X86
+// Split 8 pixels to B, G, R channel in 16 bits lanes.
+__attribute__((target("sse2")))
+static inline void loadPixelsSSE2(const unsigned char *p, __m128i &b, __m128i &g, __m128i &r)
+{
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128((const __m128i *) p);
+    __m128i p1 = _mm_loadu_si128((const __m128i *) (p + 16));
+
+    b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i computeYSSE2(__m128i b, __m128i g, __m128i r)
+{
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+
+    return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i computeChromaSSE2(__m128i b, __m128i g, __m128i r, short cr, short cg, short cb)
+{
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+    c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(128)));
+
+    return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+}
+
+// Average 2x2 blocks of 16 pixels (8 pixels in each row of two groups) to 8 values.
+__attribute__((target("sse2")))
+static inline __m128i averageSSE2(__m128i row0a, __m128i row1a, __m128i row0b, __m128i row1b)
+{
+    __m128i ones = _mm_set1_epi16(1);
+    __m128i sumA = _mm_madd_epi16(_mm_add_epi16(row0a, row1a), ones);
+    __m128i sumB = _mm_madd_epi16(_mm_add_epi16(row0b, row1b), ones);
+
+    return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(sumA, sumB), _mm_set1_epi16(2)), 2);
+}
+
+__attribute__((target("sse2")))
+static void convertRowsSSE2(const unsigned char *row0, const unsigned char *row1, int width,
+                            unsigned char *y0, unsigned char *y1,
+                            unsigned char *u, unsigned char *v, unsigned char *uv)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i b0a, g0a, r0a, b0b, g0b, r0b, b1a, g1a, r1a, b1b, g1b, r1b;
+        loadPixelsSSE2(row0 + x * 4, b0a, g0a, r0a);
+        loadPixelsSSE2(row0 + x * 4 + 32, b0b, g0b, r0b);
+        loadPixelsSSE2(row1 + x * 4, b1a, g1a, r1a);
+        loadPixelsSSE2(row1 + x * 4 + 32, b1b, g1b, r1b);
+
+        _mm_storeu_si128((__m128i *) (y0 + x), _mm_packus_epi16(computeYSSE2(b0a, g0a, r0a), computeYSSE2(b0b, g0b, r0b)));
+        _mm_storeu_si128((__m128i *) (y1 + x), _mm_packus_epi16(computeYSSE2(b1a, g1a, r1a), computeYSSE2(b1b, g1b, r1b)));
+
+        __m128i b = averageSSE2(b0a, b1a, b0b, b1b);
+        __m128i g = averageSSE2(g0a, g1a, g0b, g1b);
+        __m128i r = averageSSE2(r0a, r1a, r0b, r1b);
+        __m128i u8 = _mm_packus_epi16(computeChromaSSE2(b, g, r, -38, -74, 112), _mm_setzero_si128());
+        __m128i v8 = _mm_packus_epi16(computeChromaSSE2(b, g, r, 112, -94, -18), _mm_setzero_si128());
+
+        if (uv) {
+            _mm_storeu_si128((__m128i *) (uv + x), _mm_unpacklo_epi8(u8, v8));
+        } else {
+            _mm_storel_epi64((__m128i *) (u + x / 2), u8);
+            _mm_storel_epi64((__m128i *) (v + x / 2), v8);
+        }
+    }
+
+    if (x < width) {
+        convertRowsScalar(row0 + x * 4, row1 + x * 4, width - x, y0 + x, y1 + x,
+                          u + x / 2, v + x / 2, uv ? uv + x : NULL);
+    }
+}
+
+// Split 16 pixels to B, G, R channel in 16 bits lanes.
+// Pack instructions work inside 128 bits lanes, so permute to restore pixel order.
+__attribute__((target("avx2")))
+static inline void loadPixelsAVX2(const unsigned char *p, __m256i &b, __m256i &g, __m256i &r)
+{
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i p0 = _mm256_loadu_si256((const __m256i *) p);
+    __m256i p1 = _mm256_loadu_si256((const __m256i *) (p + 32));
+
+    b = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask)), 0xD8);
+    g = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                                                    _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask)), 0xD8);
+    r = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                                                    _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask)), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i computeYAVX2(__m256i b, __m256i g, __m256i r)
+{
+    __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)), _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+    y = _mm256_add_epi16(y, _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(25)), _mm256_set1_epi16(128)));
+
+    return _mm256_add_epi16(_mm256_srli_epi16(y, 8), _mm256_set1_epi16(16));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i computeChromaAVX2(__m256i b, __m256i g, __m256i r, short cr, short cg, short cb)
+{
+    __m256i c = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(cr)), _mm256_mullo_epi16(g, _mm256_set1_epi16(cg)));
+    c = _mm256_add_epi16(c, _mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(cb)), _mm256_set1_epi16(128)));
+
+    return _mm256_add_epi16(_mm256_srai_epi16(c, 8), _mm256_set1_epi16(128));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i averageAVX2(__m256i row0a, __m256i row1a, __m256i row0b, __m256i row1b)
+{
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i sumA = _mm256_madd_epi16(_mm256_add_epi16(row0a, row1a), ones);
+    __m256i sumB = _mm256_madd_epi16(_mm256_add_epi16(row0b, row1b), ones);
+    __m256i sum = _mm256_permute4x64_epi64(_mm256_packs_epi32(sumA, sumB), 0xD8);
+
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+// Pack 16 values of 16 bits to 16 bytes.
+__attribute__((target("avx2")))
+static inline __m128i packBytesAVX2(__m256i value)
+{
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(value, _mm256_setzero_si256()), 0xD8));
+}
+
+__attribute__((target("avx2")))
+static void convertRowsAVX2(const unsigned char *row0, const unsigned char *row1, int width,
+                            unsigned char *y0, unsigned char *y1,
+                            unsigned char *u, unsigned char *v, unsigned char *uv)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i b0a, g0a, r0a, b0b, g0b, r0b, b1a, g1a, r1a, b1b, g1b, r1b;
+        loadPixelsAVX2(row0 + x * 4, b0a, g0a, r0a);
+        loadPixelsAVX2(row0 + x * 4 + 64, b0b, g0b, r0b);
+        loadPixelsAVX2(row1 + x * 4, b1a, g1a, r1a);
+        loadPixelsAVX2(row1 + x * 4 + 64, b1b, g1b, r1b);
+
+        __m256i yRow0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(computeYAVX2(b0a, g0a, r0a), computeYAVX2(b0b, g0b, r0b)), 0xD8);
+        __m256i yRow1 = _mm256_permute4x64_epi64(_mm256_packus_epi16(computeYAVX2(b1a, g1a, r1a), computeYAVX2(b1b, g1b, r1b)), 0xD8);
+        _mm256_storeu_si256((__m256i *) (y0 + x), yRow0);
+        _mm256_storeu_si256((__m256i *) (y1 + x), yRow1);
+
+        __m256i b = averageAVX2(b0a, b1a, b0b, b1b);
+        __m256i g = averageAVX2(g0a, g1a, g0b, g1b);
+        __m256i r = averageAVX2(r0a, r1a, r0b, r1b);
+        __m128i u8 = packBytesAVX2(computeChromaAVX2(b, g, r, -38, -74, 112));
+        __m128i v8 = packBytesAVX2(computeChromaAVX2(b, g, r, 112, -94, -18));
+
+        if (uv) {
+            _mm_storeu_si128((__m128i *) (uv + x), _mm_unpacklo_epi8(u8, v8));
+            _mm_storeu_si128((__m128i *) (uv + x + 16), _mm_unpackhi_epi8(u8, v8));
+        } else {
+            _mm_storeu_si128((__m128i *) (u + x / 2), u8);
+            _mm_storeu_si128((__m128i *) (v + x / 2), v8);
+        }
+    }
+
+    if (x < width) {
+        convertRowsSSE2(row0 + x * 4, row1 + x * 4, width - x, y0 + x, y1 + x,
+                        u + x / 2, v + x / 2, uv ? uv + x : NULL);
+    }
+}
+#endif
+
+#ifdef COLOR_CONVERT_NEON
+static inline uint8x8_t computeYNEON(uint8x8_t b, uint8x8_t g, uint8x8_t r)
+{
+    uint16x8_t y = vmull_u8(r, vdup_n_u8(66));
+    y = vmlal_u8(y, g, vdup_n_u8(129));
+    y = vmlal_u8(y, b, vdup_n_u8(25));
+
+    return vadd_u8(vshrn_n_u16(vaddq_u16(y, vdupq_n_u16(128)), 8), vdup_n_u8(16));
+}
+
+static inline uint8x8_t computeChromaNEON(int16x8_t b, int16x8_t g, int16x8_t r, short cr, short cg, short cb)
+{
+    int16x8_t c = vmulq_n_s16(r, cr);
+    c = vmlaq_n_s16(c, g, cg);
+    c = vmlaq_n_s16(c, b, cb);
+    c = vaddq_s16(vshrq_n_s16(vaddq_s16(c, vdupq_n_s16(128)), 8), vdupq_n_s16(128));
+
+    return vmovn_u16(vreinterpretq_u16_s16(c));
+}
+
+// Average 2x2 blocks of 16 pixels to 8 values, rounding shift add 2 before shift.
+static inline int16x8_t averageNEON(uint8x16_t row0, uint8x16_t row1)
+{
+    return vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(row0), vpaddlq_u8(row1)), 2));
+}
+
+static void convertRowsNEON(const unsigned char *row0, const unsigned char *row1, int width,
+                            unsigned char *y0, unsigned char *y1,
+                            unsigned char *u, unsigned char *v, unsigned char *uv)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // De-interleave 16 pixels to B, G, R, A.
+        uint8x16x4_t p0 = vld4q_u8(row0 + x * 4);
+        uint8x16x4_t p1 = vld4q_u8(row1 + x * 4);
+
+        vst1q_u8(y0 + x, vcombine_u8(computeYNEON(vget_low_u8(p0.val[0]), vget_low_u8(p0.val[1]), vget_low_u8(p0.val[2])),
+                                     computeYNEON(vget_high_u8(p0.val[0]), vget_high_u8(p0.val[1]), vget_high_u8(p0.val[2]))));
+        vst1q_u8(y1 + x, vcombine_u8(computeYNEON(vget_low_u8(p1.val[0]), vget_low_u8(p1.val[1]), vget_low_u8(p1.val[2])),
+                                     computeYNEON(vget_high_u8(p1.val[0]), vget_high_u8(p1.val[1]), vget_high_u8(p1.val[2]))));
+
+        int16x8_t b = averageNEON(p0.val[0], p1.val[0]);
+        int16x8_t g = averageNEON(p0.val[1], p1.val[1]);
+        int16x8_t r = averageNEON(p0.val[2], p1.val[2]);
+        uint8x8_t u8 = computeChromaNEON(b, g, r, -38, -74, 112);
+        uint8x8_t v8 = computeChromaNEON(b, g, r, 112, -94, -18);
+
+        if (uv) {
+            uint8x8x2_t chroma = {{u8, v8}};
+            vst2_u8(uv + x, chroma);
+        } else {
+            vst1_u8(u + x / 2, u8);
+            vst1_u8(v + x / 2, v8);
+        }
+    }
+
+    if (x < width) {
+        convertRowsScalar(row0 + x * 4, row1 + x * 4, width - x, y0 + x, y1 + x,
+                          u + x / 2, v + x / 2, uv ? uv + x : NULL);
+    }
+}
+#endif
+
+static ConvertRowsFunc getConvertRowsFunc(int implementation)
+{
+#ifdef COLOR_CONVERT_X86
+    if (implementation == ColorConvert::IMPLEMENTATION_AVX2) {
+        return convertRowsAVX2;
+    } else if (implementation == ColorConvert::IMPLEMENTATION_SSE2) {
+        return convertRowsSSE2;
+    }
+#endif
+
+#ifdef COLOR_CONVERT_NEON
+    if (implementation == ColorConvert::IMPLEMENTATION_NEON) {
+        return convertRowsNEON;
+    }
+#endif
+
+    return convertRowsScalar;
+}
+
+static void convertFrame(ConvertRowsFunc func, const unsigned char *src, int srcStride, int width, int height,
+                         unsigned char *dstY, int strideY,
+                         unsigned char *dstU, int strideU,
+                         unsigned char *dstV, int strideV,
+                         unsigned char *dstUV, int strideUV)
+{
+    for (int y = 0; y < height; y += 2) {
+        const unsigned char *row0 = src + y * srcStride;
+        unsigned char *y0 = dstY + y * strideY;
+
+        func(row0, row0 + srcStride, width, y0, y0 + strideY,
+             dstU ? dstU + (y / 2) * strideU : NULL,
+             dstV ? dstV + (y / 2) * strideV : NULL,
+             dstUV ? dstUV + (y / 2) * strideUV : NULL);
+    }
+}
+
+static int pickImplementation()
+{
+    int implementation = ColorConvert::IMPLEMENTATION_SCALAR;
+    if (ColorConvert::isSupported(ColorConvert::IMPLEMENTATION_AVX2)) {
+        implementation = ColorConvert::IMPLEMENTATION_AVX2;
+    } else if (ColorConvert::isSupported(ColorConvert::IMPLEMENTATION_SSE2)) {
+        implementation = ColorConvert::IMPLEMENTATION_SSE2;
+    } else if (ColorConvert::isSupported(ColorConvert::IMPLEMENTATION_NEON)) {
+        implementation = ColorConvert::IMPLEMENTATION_NEON;
+    }
+
+    if (implementation != ColorConvert::IMPLEMENTATION_SCALAR && !ColorConvert::verify(implementation)) {
+        qDebug() << QString("%1 color convert not match scalar version, fallback to scalar.").arg(ColorConvert::getImplementationName(implementation));
+        implementation = ColorConvert::IMPLEMENTATION_SCALAR;
+    }
+
+    return implementation;
+}
+
+static int& currentImplementation()
+{
+    static int implementation = pickImplementation();
+
+    return implementation;
+}
+
+void ColorConvert::bgraToI420(const unsigned char *src, int srcStride, int width, int height,
+                              unsigned char *dstY, int strideY,
+                              unsigned char *dstU, int strideU,
+                              unsigned char *dstV, int strideV)
+{
+    convertFrame(getConvertRowsFunc(currentImplementation()), src, srcStride, width, height,
+                 dstY, strideY, dstU, strideU, dstV, strideV, NULL, 0);
+}
+
+void ColorConvert::bgraToNV12(const unsigned char *src, int srcStride, int width, int height,
+                              unsigned char *dstY, int strideY,
+                              unsigned char *dstUV, int strideUV)
+{
+    convertFrame(getConvertRowsFunc(currentImplementation()), src, srcStride, width, height,
+                 dstY, strideY, NULL, 0, NULL, 0, dstUV, strideUV);
+}
+
+bool ColorConvert::isSupported(int implementation)
+{
+    if (implementation == IMPLEMENTATION_SCALAR) {
+        return true;
+    }
+
+#ifdef COLOR_CONVERT_X86
+    __builtin_cpu_init();
+    if (implementation == IMPLEMENTATION_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    } else if (implementation == IMPLEMENTATION_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+
+#ifdef COLOR_CONVERT_NEON
+    if (implementation == IMPLEMENTATION_NEON) {
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+bool ColorConvert::verify(int implementation)
+{
+    if (!isSupported(implementation)) {
+        return false;
+    }
+
+    // Width is not multiple of any SIMD step, make sure tail pixels are checked too.
+    const int width = 102;
+    const int height = 4;
+    const int ySize = width * height;
+    const int chromaSize = ySize / 4;
+
+    QVector<unsigned char> src(width * 4 * height);
+    unsigned int seed = 2017;
+    for (int i = 0; i < src.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        src[i] = (seed >> 16) & 0xFF;
+    }
+    // Extremes of every channel.
+    memset(src.data(), 0xFF, 32);
+    memset(src.data() + width * 4, 0x00, 32);
+
+    QVector<unsigned char> expectI420(ySize + chromaSize * 2);
+    QVector<unsigned char> resultI420(ySize + chromaSize * 2);
+    convertFrame(convertRowsScalar, src.constData(), width * 4, width, height,
+                 expectI420.data(), width,
+                 expectI420.data() + ySize, width / 2,
+                 expectI420.data() + ySize + chromaSize, width / 2,
+                 NULL, 0);
+    convertFrame(getConvertRowsFunc(implementation), src.constData(), width * 4, width, height,
+                 resultI420.data(), width,
+                 resultI420.data() + ySize, width / 2,
+                 resultI420.data() + ySize + chromaSize, width / 2,
+                 NULL, 0);
+
+    QVector<unsigned char> expectNV12(ySize + chromaSize * 2);
+    QVector<unsigned char> resultNV12(ySize + chromaSize * 2);
+    convertFrame(convertRowsScalar, src.constData(), width * 4, width, height,
+                 expectNV12.data(), width, NULL, 0, NULL, 0, expectNV12.data() + ySize, width);
+    convertFrame(getConvertRowsFunc(implementation), src.constData(), width * 4, width, height,
+                 resultNV12.data(), width, NULL, 0, NULL, 0, resultNV12.data() + ySize, width);
+
+    return expectI420 == resultI420 && expectNV12 == resultNV12;
+}
+
+int ColorConvert::getImplementation()
+{
+    return currentImplementation();
+}
+
+void ColorConvert::setImplementation(int implementation)
+{
+    if (isSupported(implementation)) {
+        currentImplementation() = implementation;
+    }
+}
+
+const char* ColorConvert::getImplementationName(int implementation)
+{
+    if (implementation == IMPLEMENTATION_SSE2) {
+        return "sse2";
+    } else if (implementation == IMPLEMENTATION_AVX2) {
+        return "avx2";
+    } else if (implementation == IMPLEMENTATION_NEON) {
+        return "neon";
+    } else {
+        return "scalar";
+    }
+}
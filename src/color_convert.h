@@ -0,0 +1,59 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLORCONVERT_H
+#define COLORCONVERT_H
+
+// Convert BGRA (X11 ZPixmap in little endian) to YUV 4:2:0 with BT.601 limited range.
+// Width and height must be even, src can point into bigger frame with stride,
+// so record area is converted in place without crop copy.
+//
+// Scalar, SSE2, AVX2 and NEON implementations return exactly same result,
+// fastest one that CPU support is picked at runtime and verified with scalar version before use.
+class ColorConvert
+{
+public:
+    static const int IMPLEMENTATION_SCALAR;
+    static const int IMPLEMENTATION_SSE2;
+    static const int IMPLEMENTATION_AVX2;
+    static const int IMPLEMENTATION_NEON;
+
+    // Planar Y, U, V.
+    static void bgraToI420(const unsigned char *src, int srcStride, int width, int height,
+                           unsigned char *dstY, int strideY,
+                           unsigned char *dstU, int strideU,
+                           unsigned char *dstV, int strideV);
+
+    // Planar Y, interleaved UV.
+    static void bgraToNV12(const unsigned char *src, int srcStride, int width, int height,
+                           unsigned char *dstY, int strideY,
+                           unsigned char *dstUV, int strideUV);
+
+    static bool isSupported(int implementation);
+    static bool verify(int implementation);
+    static int getImplementation();
+    static void setImplementation(int implementation);
+    static const char* getImplementationName(int implementation);
+};
+
+#endif
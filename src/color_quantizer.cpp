@@ -0,0 +1,247 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <string.h>
+#include "color_quantizer.h"
+
+const int ColorQuantizer::HISTOGRAM_SIZE = 32768;
+const int ColorQuantizer::MAX_COLORS = 256;
+
+static inline int histogramIndex(const unsigned char *pixel)
+{
+    return ((pixel[2] >> 3) << 10) | ((pixel[1] >> 3) << 5) | (pixel[0] >> 3);
+}
+
+static inline int channelValue(int index, int channel)
+{
+    return (index >> (channel * 5)) & 0x1F;
+}
+
+// Sort colors of box by one channel, channel 0 is blue, 1 is green, 2 is red.
+class ChannelLess
+{
+public:
+    ChannelLess(int c) : channel(c) {}
+
+    bool operator()(int a, int b) const
+    {
+        return channelValue(a, channel) < channelValue(b, channel);
+    }
+
+private:
+    int channel;
+};
+
+ColorQuantizer::ColorQuantizer()
+{
+    histogram.resize(HISTOGRAM_SIZE);
+    sumRed.resize(HISTOGRAM_SIZE);
+    sumGreen.resize(HISTOGRAM_SIZE);
+    sumBlue.resize(HISTOGRAM_SIZE);
+    colorMap.resize(HISTOGRAM_SIZE);
+    palette.resize(MAX_COLORS * 3);
+
+    colors.reserve(HISTOGRAM_SIZE);
+    boxStarts.reserve(MAX_COLORS);
+    boxEnds.reserve(MAX_COLORS);
+    boxCounts.reserve(MAX_COLORS);
+    boxScores.reserve(MAX_COLORS);
+    boxChannels.reserve(MAX_COLORS);
+
+    colorNum = 0;
+}
+
+int ColorQuantizer::buildPalette(const unsigned char *frame, int stride, int width, int height, int maxColors, bool hasTransparency)
+{
+    memset(histogram.data(), 0, HISTOGRAM_SIZE * sizeof(quint32));
+    memset(sumRed.data(), 0, HISTOGRAM_SIZE * sizeof(quint32));
+    memset(sumGreen.data(), 0, HISTOGRAM_SIZE * sizeof(quint32));
+    memset(sumBlue.data(), 0, HISTOGRAM_SIZE * sizeof(quint32));
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char *pixel = frame + y * stride;
+        for (int x = 0; x < width; x++, pixel += 4) {
+            if (hasTransparency && pixel[3] == 0) {
+                continue;
+            }
+
+            int index = histogramIndex(pixel);
+            histogram[index]++;
+            sumBlue[index] += pixel[0];
+            sumGreen[index] += pixel[1];
+            sumRed[index] += pixel[2];
+        }
+    }
+
+    colors.clear();
+    for (int i = 0; i < HISTOGRAM_SIZE; i++) {
+        if (histogram[i]) {
+            colors.append(i);
+        }
+    }
+
+    splitBoxes(qBound(1, maxColors, MAX_COLORS));
+
+    // Palette color is weighted average of box, histogram index map to box.
+    colorNum = boxStarts.size();
+    for (int box = 0; box < colorNum; box++) {
+        quint64 count = 0, red = 0, green = 0, blue = 0;
+        for (int i = boxStarts[box]; i < boxEnds[box]; i++) {
+            int index = colors[i];
+            count += histogram[index];
+            red += sumRed[index];
+            green += sumGreen[index];
+            blue += sumBlue[index];
+            colorMap[index] = box;
+        }
+
+        if (count) {
+            palette[box * 3] = (red + count / 2) / count;
+            palette[box * 3 + 1] = (green + count / 2) / count;
+            palette[box * 3 + 2] = (blue + count / 2) / count;
+        } else {
+            palette[box * 3] = palette[box * 3 + 1] = palette[box * 3 + 2] = 0;
+        }
+    }
+
+    return colorNum;
+}
+
+void ColorQuantizer::splitBoxes(int maxColors)
+{
+    boxStarts.clear();
+    boxEnds.clear();
+    boxCounts.clear();
+    boxScores.clear();
+    boxChannels.clear();
+    appendBox(0, colors.size());
+
+    while (boxStarts.size() < maxColors) {
+        // Split box that has widest channel range, weighted by pixel number,
+        // so large flat areas get precise colors and rare colors still get some.
+        // Only scan measured scores of boxes, colors are not visited again.
+        int bestBox = -1;
+        quint64 bestScore = 0;
+        for (int box = 0; box < boxStarts.size(); box++) {
+            if (boxScores[box] > bestScore) {
+                bestScore = boxScores[box];
+                bestBox = box;
+            }
+        }
+
+        if (bestBox < 0) {
+            break;
+        }
+
+        // Split at median of pixel number along chosen channel.
+        int start = boxStarts[bestBox];
+        int end = boxEnds[bestBox];
+        quint64 total = boxCounts[bestBox];
+        std::sort(colors.begin() + start, colors.begin() + end, ChannelLess(boxChannels[bestBox]));
+
+        quint64 count = 0;
+        int middle = start + 1;
+        for (int i = start; i < end - 1; i++) {
+            count += histogram[colors[i]];
+            middle = i + 1;
+            if (count * 2 >= total) {
+                break;
+            }
+        }
+
+        // Split box keep lower half, upper half is appended.
+        boxEnds[bestBox] = middle;
+        measureBox(bestBox);
+        appendBox(middle, end);
+    }
+}
+
+void ColorQuantizer::appendBox(int start, int end)
+{
+    boxStarts.append(start);
+    boxEnds.append(end);
+    boxCounts.append(0);
+    boxScores.append(0);
+    boxChannels.append(0);
+    measureBox(boxStarts.size() - 1);
+}
+
+void ColorQuantizer::measureBox(int box)
+{
+    int minValue[3] = {31, 31, 31};
+    int maxValue[3] = {0, 0, 0};
+    quint64 count = 0;
+    for (int i = boxStarts[box]; i < boxEnds[box]; i++) {
+        for (int channel = 0; channel < 3; channel++) {
+            int value = channelValue(colors[i], channel);
+            minValue[channel] = std::min(minValue[channel], value);
+            maxValue[channel] = std::max(maxValue[channel], value);
+        }
+        count += histogram[colors[i]];
+    }
+
+    // Box with single color can't split, zero score is never chosen.
+    boxCounts[box] = count;
+    boxScores[box] = 0;
+    boxChannels[box] = 0;
+    if (boxEnds[box] - boxStarts[box] < 2) {
+        return;
+    }
+
+    for (int channel = 0; channel < 3; channel++) {
+        quint64 score = (quint64) (maxValue[channel] - minValue[channel]) * count;
+        if (score > boxScores[box]) {
+            boxScores[box] = score;
+            boxChannels[box] = channel;
+        }
+    }
+}
+
+void ColorQuantizer::mapPixels(const unsigned char *frame, int stride, int width, int height, int transparentIndex, unsigned char *indexes)
+{
+    const unsigned char *map = colorMap.constData();
+    for (int y = 0; y < height; y++) {
+        const unsigned char *pixel = frame + y * stride;
+        unsigned char *output = indexes + y * width;
+        if (transparentIndex >= 0) {
+            for (int x = 0; x < width; x++, pixel += 4) {
+                output[x] = pixel[3] == 0 ? transparentIndex : map[histogramIndex(pixel)];
+            }
+        } else {
+            for (int x = 0; x < width; x++, pixel += 4) {
+                output[x] = map[histogramIndex(pixel)];
+            }
+        }
+    }
+}
+
+const unsigned char* ColorQuantizer::getPalette()
+{
+    return palette.constData();
+}
+
+int ColorQuantizer::getColorNum()
+{
+    return colorNum;
+}
@@ -0,0 +1,78 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLORQUANTIZER_H
+#define COLORQUANTIZER_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// Median cut color quantizer for GIF frames.
+// Colors are counted in 15 bits histogram (5 bits per channel),
+// palette color is average of real colors in each box, so frames with few colors
+// (most screen content) keep exact colors.
+class ColorQuantizer
+{
+public:
+    static const int HISTOGRAM_SIZE;
+    static const int MAX_COLORS;
+
+    ColorQuantizer();
+
+    // Build palette of BGRA frame, return color number.
+    // If hasTransparency is true, pixels with zero alpha are transparent and not counted.
+    int buildPalette(const unsigned char *frame, int stride, int width, int height, int maxColors, bool hasTransparency);
+
+    // Map pixels to palette index, palette must be built from same frame.
+    // Pixels with zero alpha are mapped to transparentIndex if it isn't -1.
+    void mapPixels(const unsigned char *frame, int stride, int width, int height, int transparentIndex, unsigned char *indexes);
+
+    // RGB triples.
+    const unsigned char* getPalette();
+    int getColorNum();
+
+private:
+    void splitBoxes(int maxColors);
+    void appendBox(int start, int end);
+    void measureBox(int box);
+
+    QVector<quint32> histogram;
+    QVector<quint32> sumRed;
+    QVector<quint32> sumGreen;
+    QVector<quint32> sumBlue;
+
+    // Histogram index of every non-empty color, boxes are ranges of this array.
+    // Pixel number and split score (widest channel range by pixel number) are measured once when box is created.
+    QVector<int> colors;
+    QVector<int> boxStarts;
+    QVector<int> boxEnds;
+    QVector<quint64> boxCounts;
+    QVector<quint64> boxScores;
+    QVector<int> boxChannels;
+
+    QVector<unsigned char> colorMap;
+    QVector<unsigned char> palette;
+    int colorNum;
+};
+
+#endif
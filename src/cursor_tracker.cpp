@@ -0,0 +1,254 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <algorithm>
+#include <stdlib.h>
+#include "cursor_tracker.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Premultiplied source over: dst = src + dst * (255 - alpha) / 255.
+// Division by 255 is done as (t + (t >> 8)) >> 8 with t = x + 128, exact for 8 bits values.
+static inline quint32 blendPixel(quint32 src, quint32 dst)
+{
+    quint32 inverseAlpha = 255 - (src >> 24);
+    quint32 result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        quint32 t = ((dst >> shift) & 0xFF) * inverseAlpha + 128;
+        quint32 value = ((src >> shift) & 0xFF) + ((t + (t >> 8)) >> 8);
+        result |= value << shift;
+    }
+
+    return result;
+}
+
+static void blendRowScalar(quint32 *dst, const quint32 *src, int width)
+{
+    for (int x = 0; x < width; x++) {
+        quint32 alpha = src[x] >> 24;
+        if (alpha == 255) {
+            dst[x] = src[x];
+        } else if (alpha) {
+            dst[x] = blendPixel(src[x], dst[x]);
+        }
+    }
+}
+
+#ifdef __SSE2__
+// Same formula as scalar version, 4 pixels at once in 16 bits lanes.
+static inline __m128i blendHalfSSE2(__m128i src, __m128i dst)
+{
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xFF), 0xFF);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, _mm_sub_epi16(_mm_set1_epi16(255), alpha)), _mm_set1_epi16(128));
+    t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+    return _mm_add_epi16(src, t);
+}
+
+static void blendRowSSE2(quint32 *dst, const quint32 *src, int width)
+{
+    __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + x));
+
+        // Most cursor pixels are fully transparent or opaque.
+        int alphaMask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(s, 24), zero));
+        if (alphaMask == 0xFFFF) {
+            continue;
+        }
+
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + x));
+        __m128i low = blendHalfSSE2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i high = blendHalfSSE2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i *) (dst + x), _mm_packus_epi16(low, high));
+    }
+
+    blendRowScalar(dst + x, src + x, width - x);
+}
+#endif
+
+CursorTracker::CursorTracker()
+{
+    conn = NULL;
+    rootWindow = XCB_NONE;
+    firstEvent = -1;
+    isCursorChanged = true;
+    serial = 0;
+    pointerX = 0;
+    pointerY = 0;
+}
+
+CursorTracker::~CursorTracker()
+{
+    qDeleteAll(images);
+}
+
+bool CursorTracker::init(xcb_connection_t *connection, xcb_window_t root)
+{
+    conn = connection;
+    rootWindow = root;
+
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(conn, &xcb_xfixes_id);
+    if (!extension || !extension->present) {
+        qDebug() << "XFixes extension not present, cursor won't be recorded";
+        return false;
+    }
+    firstEvent = extension->first_event;
+
+    // Cursor notify need XFixes 2.0.
+    xcb_xfixes_query_version_reply_t *versionReply = xcb_xfixes_query_version_reply(
+        conn, xcb_xfixes_query_version(conn, XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION), NULL);
+    if (!versionReply || versionReply->major_version < 2) {
+        qDebug() << "XFixes 2.0 not supported, cursor won't be recorded";
+        free(versionReply);
+        return false;
+    }
+    free(versionReply);
+
+    xcb_xfixes_select_cursor_input(conn, rootWindow, XCB_XFIXES_CURSOR_NOTIFY_MASK_DISPLAY_CURSOR);
+    isCursorChanged = true;
+
+    return update();
+}
+
+bool CursorTracker::handleEvent(xcb_generic_event_t *event)
+{
+    if (firstEvent < 0 || (event->response_type & ~0x80) != firstEvent + XCB_XFIXES_CURSOR_NOTIFY) {
+        return false;
+    }
+
+    // Image is fetched at next update, skip if cursor is cached already.
+    xcb_xfixes_cursor_notify_event_t *notifyEvent = (xcb_xfixes_cursor_notify_event_t *) event;
+    QMutexLocker locker(&mutex);
+    if (images.contains(notifyEvent->cursor_serial)) {
+        serial = notifyEvent->cursor_serial;
+    } else {
+        isCursorChanged = true;
+    }
+
+    return true;
+}
+
+bool CursorTracker::update()
+{
+    if (!conn) {
+        return false;
+    }
+
+    xcb_query_pointer_cookie_t pointerCookie = xcb_query_pointer(conn, rootWindow);
+    if (isCursorChanged && fetchImage()) {
+        isCursorChanged = false;
+    }
+
+    xcb_query_pointer_reply_t *pointerReply = xcb_query_pointer_reply(conn, pointerCookie, NULL);
+    if (!pointerReply) {
+        return false;
+    }
+    pointerX = pointerReply->root_x;
+    pointerY = pointerReply->root_y;
+    free(pointerReply);
+
+    return true;
+}
+
+int CursorTracker::getX()
+{
+    const CursorImage *image = getImage(serial);
+    return image ? pointerX - image->xhot : pointerX;
+}
+
+int CursorTracker::getY()
+{
+    const CursorImage *image = getImage(serial);
+    return image ? pointerY - image->yhot : pointerY;
+}
+
+quint32 CursorTracker::getSerial()
+{
+    return serial;
+}
+
+const CursorImage* CursorTracker::getImage(quint32 cursorSerial)
+{
+    QMutexLocker locker(&mutex);
+
+    return images.value(cursorSerial, NULL);
+}
+
+bool CursorTracker::fetchImage()
+{
+    xcb_xfixes_get_cursor_image_reply_t *reply = xcb_xfixes_get_cursor_image_reply(conn, xcb_xfixes_get_cursor_image(conn), NULL);
+    if (!reply) {
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    serial = reply->cursor_serial;
+    if (!images.contains(serial)) {
+        CursorImage *image = new CursorImage();
+        image->width = reply->width;
+        image->height = reply->height;
+        image->xhot = reply->xhot;
+        image->yhot = reply->yhot;
+
+        const uint32_t *pixels = xcb_xfixes_get_cursor_image_cursor_image(reply);
+        image->pixels.resize(image->width * image->height);
+        std::copy(pixels, pixels + image->width * image->height, image->pixels.begin());
+
+        images.insert(serial, image);
+    }
+    free(reply);
+
+    return true;
+}
+
+void CursorTracker::blendCursor(unsigned char *frame, int stride, int width, int height, int x, int y, const CursorImage *image)
+{
+    if (!image) {
+        return;
+    }
+
+    // Clip cursor with frame.
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + image->width, width);
+    int bottom = std::min(y + image->height, height);
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    for (int row = top; row < bottom; row++) {
+        quint32 *dst = (quint32 *) (frame + row * stride) + left;
+        const quint32 *src = image->pixels.constData() + (row - y) * image->width + (left - x);
+#ifdef __SSE2__
+        blendRowSSE2(dst, src, right - left);
+#else
+        blendRowScalar(dst, src, right - left);
+#endif
+    }
+}
@@ -0,0 +1,86 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CURSORTRACKER_H
+#define CURSORTRACKER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <xcb/xcb.h>
+#include <xcb/xfixes.h>
+
+// Cursor image in premultiplied ARGB, XFixes already return premultiplied pixels.
+struct CursorImage {
+    int width;
+    int height;
+    int xhot;
+    int yhot;
+    QVector<quint32> pixels;
+};
+
+// Track cursor with XFixes cursor notify events, cursor is not part of screen image,
+// so we draw it into frames ourselves. Every cursor image is fetched once and cached by serial,
+// cursor move only need query pointer position.
+class CursorTracker
+{
+public:
+    CursorTracker();
+    ~CursorTracker();
+
+    bool init(xcb_connection_t *connection, xcb_window_t root);
+
+    // Return true if event is cursor notify event, caller still own event.
+    bool handleEvent(xcb_generic_event_t *event);
+
+    // Update pointer position, and fetch cursor image if cursor changed.
+    bool update();
+
+    // Position of cursor image top left corner in root window.
+    int getX();
+    int getY();
+    quint32 getSerial();
+
+    // Cached image never change or free before tracker destroyed, so other thread can read it.
+    const CursorImage* getImage(quint32 serial);
+
+    // Blend cursor (at x, y of frame) over BGRA frame.
+    static void blendCursor(unsigned char *frame, int stride, int width, int height, int x, int y, const CursorImage *image);
+
+private:
+    bool fetchImage();
+
+    xcb_connection_t *conn;
+    xcb_window_t rootWindow;
+    int firstEvent;
+
+    bool isCursorChanged;
+    quint32 serial;
+    int pointerX;
+    int pointerY;
+
+    QMutex mutex;
+    QHash<quint32, CursorImage*> images;
+};
+
+#endif
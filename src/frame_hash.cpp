@@ -0,0 +1,205 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "frame_hash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_HASH_X86
+#endif
+
+// Row is hashed by 32 bytes block, every block update four 64-bit lanes:
+// lane += data + low32(data ^ key) * high32(data ^ key), key changed with block index,
+// so move blocks around in row will change hash.
+static const quint64 HASH_SECRET[4] = {
+    0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0x85EBCA77C2B2AE63ULL
+};
+static const quint64 HASH_KEY_STEP = 0x27D4EB2F165667C5ULL;
+static const int HASH_BLOCK_SIZE = 32;
+
+static inline quint64 mix64(quint64 h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+// Merge lanes and bytes that not fill a whole block.
+static quint64 finishHash(const quint64 *lanes, const unsigned char *tail, int tailBytes, int rowBytes)
+{
+    quint64 h = mix64((quint64) rowBytes);
+    for (int i = 0; i < 4; i++) {
+        h = mix64(h ^ lanes[i]);
+    }
+
+    while (tailBytes > 0) {
+        quint64 value = 0;
+        int size = tailBytes < 8 ? tailBytes : 8;
+        memcpy(&value, tail, size);
+        h = mix64(h ^ value);
+
+        tail += size;
+        tailBytes -= size;
+    }
+
+    return h;
+}
+
+quint64 FrameHash::hashRowScalar(const unsigned char *row, int rowBytes)
+{
+    quint64 lanes[4] = {0, 0, 0, 0};
+    quint64 keys[4] = {HASH_SECRET[0], HASH_SECRET[1], HASH_SECRET[2], HASH_SECRET[3]};
+    int blockNum = rowBytes / HASH_BLOCK_SIZE;
+
+    for (int block = 0; block < blockNum; block++) {
+        for (int i = 0; i < 4; i++) {
+            quint64 data;
+            memcpy(&data, row + block * HASH_BLOCK_SIZE + i * 8, 8);
+
+            quint64 key = data ^ keys[i];
+            lanes[i] += data + (key & 0xFFFFFFFFULL) * (key >> 32);
+            keys[i] += HASH_KEY_STEP;
+        }
+    }
+
+    return finishHash(lanes, row + blockNum * HASH_BLOCK_SIZE, rowBytes - blockNum * HASH_BLOCK_SIZE, rowBytes);
+}
+
+#ifdef FRAME_HASH_X86
+__attribute__((target("sse2")))
+quint64 FrameHash::hashRowSSE2(const unsigned char *row, int rowBytes)
+{
+    __m128i lane01 = _mm_setzero_si128();
+    __m128i lane23 = _mm_setzero_si128();
+    __m128i key01 = _mm_set_epi64x(HASH_SECRET[1], HASH_SECRET[0]);
+    __m128i key23 = _mm_set_epi64x(HASH_SECRET[3], HASH_SECRET[2]);
+    __m128i step = _mm_set1_epi64x(HASH_KEY_STEP);
+    int blockNum = rowBytes / HASH_BLOCK_SIZE;
+
+    for (int block = 0; block < blockNum; block++) {
+        const unsigned char *p = row + block * HASH_BLOCK_SIZE;
+        __m128i data01 = _mm_loadu_si128((const __m128i *) p);
+        __m128i data23 = _mm_loadu_si128((const __m128i *) (p + 16));
+
+        __m128i k01 = _mm_xor_si128(data01, key01);
+        __m128i k23 = _mm_xor_si128(data23, key23);
+        lane01 = _mm_add_epi64(lane01, _mm_add_epi64(data01, _mm_mul_epu32(k01, _mm_srli_epi64(k01, 32))));
+        lane23 = _mm_add_epi64(lane23, _mm_add_epi64(data23, _mm_mul_epu32(k23, _mm_srli_epi64(k23, 32))));
+
+        key01 = _mm_add_epi64(key01, step);
+        key23 = _mm_add_epi64(key23, step);
+    }
+
+    quint64 lanes[4];
+    _mm_storeu_si128((__m128i *) lanes, lane01);
+    _mm_storeu_si128((__m128i *) (lanes + 2), lane23);
+
+    return finishHash(lanes, row + blockNum * HASH_BLOCK_SIZE, rowBytes - blockNum * HASH_BLOCK_SIZE, rowBytes);
+}
+
+__attribute__((target("avx2")))
+quint64 FrameHash::hashRowAVX2(const unsigned char *row, int rowBytes)
+{
+    __m256i lane = _mm256_setzero_si256();
+    __m256i key = _mm256_set_epi64x(HASH_SECRET[3], HASH_SECRET[2], HASH_SECRET[1], HASH_SECRET[0]);
+    __m256i step = _mm256_set1_epi64x(HASH_KEY_STEP);
+    int blockNum = rowBytes / HASH_BLOCK_SIZE;
+
+    for (int block = 0; block < blockNum; block++) {
+        __m256i data = _mm256_loadu_si256((const __m256i *) (row + block * HASH_BLOCK_SIZE));
+        __m256i k = _mm256_xor_si256(data, key);
+        lane = _mm256_add_epi64(lane, _mm256_add_epi64(data, _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32))));
+        key = _mm256_add_epi64(key, step);
+    }
+
+    quint64 lanes[4];
+    _mm256_storeu_si256((__m256i *) lanes, lane);
+
+    return finishHash(lanes, row + blockNum * HASH_BLOCK_SIZE, rowBytes - blockNum * HASH_BLOCK_SIZE, rowBytes);
+}
+#else
+quint64 FrameHash::hashRowSSE2(const unsigned char *row, int rowBytes)
+{
+    return hashRowScalar(row, rowBytes);
+}
+
+quint64 FrameHash::hashRowAVX2(const unsigned char *row, int rowBytes)
+{
+    return hashRowScalar(row, rowBytes);
+}
+#endif
+
+typedef quint64 (*HashRowFunc)(const unsigned char *row, int rowBytes);
+
+struct HashImplementation {
+    HashRowFunc func;
+    const char *name;
+};
+
+static HashImplementation pickImplementation()
+{
+    HashImplementation impl = {FrameHash::hashRowScalar, "scalar"};
+
+#ifdef FRAME_HASH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        impl.func = FrameHash::hashRowAVX2;
+        impl.name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        impl.func = FrameHash::hashRowSSE2;
+        impl.name = "sse2";
+    }
+#endif
+
+    return impl;
+}
+
+static const HashImplementation& getImplementation()
+{
+    static HashImplementation impl = pickImplementation();
+
+    return impl;
+}
+
+quint64 FrameHash::hashRow(const unsigned char *row, int rowBytes)
+{
+    return getImplementation().func(row, rowBytes);
+}
+
+void FrameHash::hashRows(const unsigned char *frame, int stride, int rowBytes, int height, quint64 *hashes)
+{
+    HashRowFunc func = getImplementation().func;
+    for (int y = 0; y < height; y++) {
+        hashes[y] = func(frame + y * stride, rowBytes);
+    }
+}
+
+const char* FrameHash::getImplementationName()
+{
+    return getImplementation().name;
+}
@@ -0,0 +1,43 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <QtGlobal>
+
+// Fast non-cryptographic hash of every frame row, use to find duplicate frames and changed rows.
+// SSE2/AVX2 implementation is picked at runtime, all implementations return same hash value.
+class FrameHash
+{
+public:
+    static void hashRows(const unsigned char *frame, int stride, int rowBytes, int height, quint64 *hashes);
+    static quint64 hashRow(const unsigned char *row, int rowBytes);
+    static const char* getImplementationName();
+
+    static quint64 hashRowScalar(const unsigned char *row, int rowBytes);
+    static quint64 hashRowSSE2(const unsigned char *row, int rowBytes);
+    static quint64 hashRowAVX2(const unsigned char *row, int rowBytes);
+};
+
+#endif
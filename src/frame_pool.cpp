@@ -0,0 +1,193 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "frame_pool.h"
+
+const int FramePool::MIN_FRAME_NUM = 2;
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+FramePool::FramePool()
+{
+    memory = NULL;
+    memorySize = 0;
+    slotSize = 0;
+    frameSize = 0;
+    capacity = 0;
+    peakUsedNum = 0;
+    hugePage = false;
+}
+
+FramePool::~FramePool()
+{
+    release();
+}
+
+bool FramePool::init(int size, qint64 memoryBudget, int maxFrameNum, bool useHugePage)
+{
+    release();
+
+    // Align every frame to page boundary, SIMD code and pipe write both like aligned memory.
+    size_t pageSize = useHugePage ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE);
+    frameSize = size;
+    slotSize = ((size_t) size + pageSize - 1) / pageSize * pageSize;
+
+    // Slots more than frames in flight are never reached by LIFO free list, don't commit memory for them.
+    capacity = std::min(memoryBudget / (qint64) slotSize, (qint64) maxFrameNum);
+    if (capacity < MIN_FRAME_NUM) {
+        qDebug() << QString("Memory budget %1 bytes is too small for %2 frames, use %2 frames anyway.").arg(memoryBudget).arg(MIN_FRAME_NUM);
+        capacity = MIN_FRAME_NUM;
+    }
+    memorySize = slotSize * capacity;
+
+    hugePage = false;
+    if (useHugePage) {
+        memory = (unsigned char *) mmap(NULL, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            qDebug() << "No reserved huge pages, fallback to transparent huge pages.";
+            memory = NULL;
+        } else {
+            hugePage = true;
+        }
+    }
+
+    if (!memory) {
+        memory = (unsigned char *) mmap(NULL, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            qDebug() << "Allocate frame pool failed, size:" << memorySize;
+            memory = NULL;
+            memorySize = 0;
+            capacity = 0;
+            return false;
+        }
+
+        if (useHugePage) {
+            madvise(memory, memorySize, MADV_HUGEPAGE);
+        }
+    }
+
+    // Touch all pages now, avoid page fault in record loop.
+    for (size_t offset = 0; offset < memorySize; offset += pageSize) {
+        memory[offset] = 0;
+    }
+
+    QMutexLocker locker(&mutex);
+    freeFrames.clear();
+    freeFrames.reserve(capacity);
+    for (int i = capacity - 1; i >= 0; i--) {
+        freeFrames.append(i);
+    }
+    peakUsedNum = 0;
+
+    qDebug() << QString("Frame pool: %1 frames x %2 bytes, %3 MB in total%4")
+        .arg(capacity).arg(slotSize).arg(memorySize / (1024 * 1024)).arg(hugePage ? ", huge pages" : "");
+
+    return true;
+}
+
+void FramePool::release()
+{
+    if (memory) {
+        munmap(memory, memorySize);
+        memory = NULL;
+    }
+
+    memorySize = 0;
+    capacity = 0;
+
+    QMutexLocker locker(&mutex);
+    freeFrames.clear();
+}
+
+int FramePool::acquire()
+{
+    QMutexLocker locker(&mutex);
+
+    if (freeFrames.isEmpty()) {
+        return -1;
+    }
+
+    int index = freeFrames.last();
+    freeFrames.removeLast();
+
+    int usedNum = capacity - freeFrames.size();
+    if (usedNum > peakUsedNum) {
+        peakUsedNum = usedNum;
+    }
+
+    return index;
+}
+
+void FramePool::recycle(int index)
+{
+    if (index < 0 || index >= capacity) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    freeFrames.append(index);
+}
+
+unsigned char* FramePool::getFrame(int index)
+{
+    return memory + slotSize * index;
+}
+
+int FramePool::getFrameSize()
+{
+    return frameSize;
+}
+
+int FramePool::getCapacity()
+{
+    return capacity;
+}
+
+int FramePool::getUsedNum()
+{
+    QMutexLocker locker(&mutex);
+
+    return capacity - freeFrames.size();
+}
+
+int FramePool::getPeakUsedNum()
+{
+    QMutexLocker locker(&mutex);
+
+    return peakUsedNum;
+}
+
+qint64 FramePool::getMemorySize()
+{
+    return memorySize;
+}
+
+bool FramePool::isHugePage()
+{
+    return hugePage;
+}
@@ -0,0 +1,70 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QMutex>
+#include <QVector>
+
+// Fixed frame slots with a free list, free list is a LIFO stack (not a ring),
+// so the slot recycled last is reused first and its memory is still hot in cache.
+class FramePool
+{
+public:
+    static const int MIN_FRAME_NUM;
+
+    FramePool();
+    ~FramePool();
+
+    // Allocate frames that pipeline can hold at most, memory budget is only upper limit,
+    // all memory is allocated here, acquire/recycle never allocate anything.
+    bool init(int frameSize, qint64 memoryBudget, int maxFrameNum, bool useHugePage);
+    void release();
+
+    // Return index of free frame, or -1 if all frames are in use.
+    int acquire();
+    void recycle(int index);
+
+    unsigned char* getFrame(int index);
+    int getFrameSize();
+    int getCapacity();
+    int getUsedNum();
+    int getPeakUsedNum();
+    qint64 getMemorySize();
+    bool isHugePage();
+
+private:
+    unsigned char *memory;
+    size_t memorySize;
+    size_t slotSize;
+    int frameSize;
+    int capacity;
+    int peakUsedNum;
+    bool hugePage;
+
+    QMutex mutex;
+    QVector<int> freeFrames;
+};
+
+#endif
@@ -0,0 +1,389 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QThread>
+#include <algorithm>
+#include <string.h>
+#include "frame_scaler.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const int FrameScaler::STRIPE_MIN_ROWS = 16;
+
+// Average every 2x2 block of source pixels.
+static void halveRowScalar(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int dstWidth)
+{
+    for (int x = 0; x < dstWidth; x++) {
+        for (int c = 0; c < 4; c++) {
+            int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+            dst[x * 4 + c] = (sum + 2) >> 2;
+        }
+    }
+}
+
+// Blend two rows with 7 bits weight of second row.
+static void blendRowsScalar(const unsigned char *row0, const unsigned char *row1, int weight, unsigned char *dst, int size)
+{
+    for (int i = 0; i < size; i++) {
+        dst[i] = (row0[i] * (128 - weight) + row1[i] * weight + 64) >> 7;
+    }
+}
+
+// Blend two neighbor pixels of every output pixel, weights are 4 x (128 - w) and 4 x w per pixel.
+static void blendColumnsScalar(const unsigned char *src, const int *indexes, const short *weights, unsigned char *dst, int dstWidth)
+{
+    for (int x = 0; x < dstWidth; x++) {
+        const unsigned char *pixel = src + indexes[x] * 4;
+        const short *weight = weights + x * 8;
+        for (int c = 0; c < 4; c++) {
+            dst[x * 4 + c] = (pixel[c] * weight[c] + pixel[4 + c] * weight[4 + c] + 64) >> 7;
+        }
+    }
+}
+
+#ifdef __SSE2__
+
+// Sum two neighbor pixels of 4 pixels in 16 bits lanes, return sums of pixel 0+1 and 2+3.
+static inline __m128i addPixelPairsSSE2(__m128i pixels, __m128i zero)
+{
+    __m128i low = _mm_unpacklo_epi8(pixels, zero);
+    __m128i high = _mm_unpackhi_epi8(pixels, zero);
+    return _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+}
+
+static void halveRowSSE2(const unsigned char *row0, const unsigned char *row1, unsigned char *dst, int dstWidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+
+    // 8 source pixels of both rows to 4 output pixels per loop.
+    int x = 0;
+    for (; x + 4 <= dstWidth; x += 4) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *) (row0 + x * 8));
+        __m128i a1 = _mm_loadu_si128((const __m128i *) (row0 + x * 8 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *) (row1 + x * 8));
+        __m128i b1 = _mm_loadu_si128((const __m128i *) (row1 + x * 8 + 16));
+
+        __m128i sum0 = _mm_add_epi16(addPixelPairsSSE2(a0, zero), addPixelPairsSSE2(b0, zero));
+        __m128i sum1 = _mm_add_epi16(addPixelPairsSSE2(a1, zero), addPixelPairsSSE2(b1, zero));
+        sum0 = _mm_srli_epi16(_mm_add_epi16(sum0, round), 2);
+        sum1 = _mm_srli_epi16(_mm_add_epi16(sum1, round), 2);
+
+        _mm_storeu_si128((__m128i *) (dst + x * 4), _mm_packus_epi16(sum0, sum1));
+    }
+
+    halveRowScalar(row0 + x * 8, row1 + x * 8, dst + x * 4, dstWidth - x);
+}
+
+static void blendRowsSSE2(const unsigned char *row0, const unsigned char *row1, int weight, unsigned char *dst, int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(64);
+    const __m128i weight0 = _mm_set1_epi16(128 - weight);
+    const __m128i weight1 = _mm_set1_epi16(weight);
+
+    // Max value 255 * 128 + 64 fit in unsigned 16 bits.
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (row0 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (row1 + i));
+
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), weight0),
+                                    _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), weight1));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), weight0),
+                                     _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), weight1));
+        low = _mm_srli_epi16(_mm_add_epi16(low, round), 7);
+        high = _mm_srli_epi16(_mm_add_epi16(high, round), 7);
+
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(low, high));
+    }
+
+    blendRowsScalar(row0 + i, row1 + i, weight, dst + i, size - i);
+}
+
+static void blendColumnsSSE2(const unsigned char *src, const int *indexes, const short *weights, unsigned char *dst, int dstWidth)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(64);
+
+    // Two output pixels per loop, each one load its two neighbor source pixels.
+    int x = 0;
+    for (; x + 2 <= dstWidth; x += 2) {
+        __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (src + indexes[x] * 4)), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (src + indexes[x + 1] * 4)), zero);
+        a = _mm_mullo_epi16(a, _mm_loadu_si128((const __m128i *) (weights + x * 8)));
+        b = _mm_mullo_epi16(b, _mm_loadu_si128((const __m128i *) (weights + x * 8 + 8)));
+
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 7);
+
+        _mm_storel_epi64((__m128i *) (dst + x * 4), _mm_packus_epi16(sum, zero));
+    }
+
+    blendColumnsScalar(src, indexes + x, weights + x * 8, dst + x * 4, dstWidth - x);
+}
+
+#endif
+
+// Source position of output pixel center in 16.16 fixed point, split into first source pixel and 7 bits weight of next one.
+static void computeTaps(int srcSize, int dstSize, QVector<int> &indexes, QVector<int> &weights)
+{
+    indexes.resize(dstSize);
+    weights.resize(dstSize);
+
+    qint64 step = ((qint64) srcSize << 16) / dstSize;
+    qint64 position = step / 2 - 32768;
+    for (int i = 0; i < dstSize; i++) {
+        qint64 clamped = position > 0 ? position : 0;
+        int index = clamped >> 16;
+        int weight = (clamped & 0xFFFF) >> 9;
+        if (index >= srcSize - 1) {
+            index = srcSize - 2;
+            weight = 128;
+        }
+
+        indexes[i] = index;
+        weights[i] = weight;
+        position += step;
+    }
+}
+
+ScaleTask::ScaleTask(FrameScaler *s, int rowBufferSize)
+{
+    scaler = s;
+    pass = 0;
+    startRow = 0;
+    endRow = 0;
+    rowBuffer.resize(rowBufferSize);
+
+    // Task is reused for every frame.
+    setAutoDelete(false);
+}
+
+void ScaleTask::setStripe(int p, int start, int end)
+{
+    pass = p;
+    startRow = start;
+    endRow = end;
+}
+
+void ScaleTask::run()
+{
+    scaler->scaleStripe(pass, startRow, endRow, rowBuffer.data());
+    scaler->finishStripe();
+}
+
+FrameScaler::FrameScaler()
+{
+    threadNum = 1;
+}
+
+FrameScaler::~FrameScaler()
+{
+    threadPool.waitForDone();
+    qDeleteAll(tasks);
+}
+
+bool FrameScaler::init(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    if (dstWidth <= 0 || dstHeight <= 0 || dstWidth > srcWidth || dstHeight > srcHeight) {
+        qDebug() << QString("Can't scale %1x%2 to %3x%4").arg(srcWidth).arg(srcHeight).arg(dstWidth).arg(dstHeight);
+        return false;
+    }
+
+    passes.clear();
+    buffers.clear();
+
+    int width = srcWidth;
+    int height = srcHeight;
+    while (width / 2 >= dstWidth && height / 2 >= dstHeight) {
+        ScalePass pass;
+        pass.srcWidth = width;
+        pass.srcHeight = height;
+        pass.dstWidth = width / 2;
+        pass.dstHeight = height / 2;
+        pass.isHalve = true;
+        passes.append(pass);
+
+        width /= 2;
+        height /= 2;
+    }
+
+    int rowBufferSize = 0;
+    if (width != dstWidth || height != dstHeight) {
+        ScalePass pass;
+        pass.srcWidth = width;
+        pass.srcHeight = height;
+        pass.dstWidth = dstWidth;
+        pass.dstHeight = dstHeight;
+        pass.isHalve = false;
+        initBilinear(pass);
+        passes.append(pass);
+
+        rowBufferSize = width * 4;
+    }
+
+    // Link passes with intermediate frames, first source and last destination are given by caller.
+    buffers.resize(std::max(passes.size() - 1, 0));
+    for (int i = 0; i + 1 < passes.size(); i++) {
+        buffers[i].resize(passes[i].dstWidth * 4 * passes[i].dstHeight);
+        passes[i].dst = buffers[i].data();
+        passes[i].dstStride = passes[i].dstWidth * 4;
+        passes[i + 1].src = buffers[i].data();
+        passes[i + 1].srcStride = passes[i].dstWidth * 4;
+    }
+
+    // Caller thread scale one stripe too, stripe should not be too short.
+    threadPool.waitForDone();
+    qDeleteAll(tasks);
+    tasks.clear();
+
+    threadNum = qBound(1, QThread::idealThreadCount(), std::max(1, dstHeight / STRIPE_MIN_ROWS));
+    threadPool.setMaxThreadCount(std::max(1, threadNum - 1));
+    for (int i = 0; i + 1 < threadNum; i++) {
+        tasks.append(new ScaleTask(this, rowBufferSize));
+    }
+    rowBuffer.resize(rowBufferSize);
+
+    return true;
+}
+
+void FrameScaler::initBilinear(ScalePass &pass)
+{
+    QVector<int> xWeights;
+    computeTaps(pass.srcWidth, pass.dstWidth, pass.xIndexes, xWeights);
+    computeTaps(pass.srcHeight, pass.dstHeight, pass.yIndexes, pass.yWeights);
+
+    pass.xWeights.resize(pass.dstWidth * 8);
+    for (int x = 0; x < pass.dstWidth; x++) {
+        for (int c = 0; c < 4; c++) {
+            pass.xWeights[x * 8 + c] = 128 - xWeights[x];
+            pass.xWeights[x * 8 + 4 + c] = xWeights[x];
+        }
+    }
+}
+
+void FrameScaler::scale(const unsigned char *src, int srcStride, unsigned char *dst, int dstStride)
+{
+    if (passes.isEmpty()) {
+        return;
+    }
+
+    passes.first().src = src;
+    passes.first().srcStride = srcStride;
+    passes.last().dst = dst;
+    passes.last().dstStride = dstStride;
+
+    // Passes run one by one, stripes of same pass are independent.
+    for (int i = 0; i < passes.size(); i++) {
+        int rows = passes[i].dstHeight;
+        int stripeNum = qBound(1, rows / STRIPE_MIN_ROWS, threadNum);
+
+        for (int stripe = 1; stripe < stripeNum; stripe++) {
+            tasks[stripe - 1]->setStripe(i, rows * stripe / stripeNum, rows * (stripe + 1) / stripeNum);
+            threadPool.start(tasks[stripe - 1]);
+        }
+        scaleStripe(i, 0, rows / stripeNum, rowBuffer.data());
+
+        finishSemaphore.acquire(stripeNum - 1);
+    }
+}
+
+void FrameScaler::scaleStripe(int index, int startRow, int endRow, unsigned char *rowBuffer)
+{
+    ScalePass &pass = passes[index];
+
+    if (pass.isHalve) {
+        for (int y = startRow; y < endRow; y++) {
+            const unsigned char *row0 = pass.src + y * 2 * pass.srcStride;
+#ifdef __SSE2__
+            halveRowSSE2(row0, row0 + pass.srcStride, pass.dst + y * pass.dstStride, pass.dstWidth);
+#else
+            halveRowScalar(row0, row0 + pass.srcStride, pass.dst + y * pass.dstStride, pass.dstWidth);
+#endif
+        }
+    } else {
+        bilinearRows(pass, startRow, endRow, rowBuffer);
+    }
+}
+
+void FrameScaler::bilinearRows(ScalePass &pass, int startRow, int endRow, unsigned char *rowBuffer)
+{
+    // Only blend columns that output pixels read.
+    int rowSize = (pass.xIndexes.last() + 2) * 4;
+
+    for (int y = startRow; y < endRow; y++) {
+        const unsigned char *row0 = pass.src + pass.yIndexes[y] * pass.srcStride;
+        unsigned char *dst = pass.dst + y * pass.dstStride;
+#ifdef __SSE2__
+        blendRowsSSE2(row0, row0 + pass.srcStride, pass.yWeights[y], rowBuffer, rowSize);
+        blendColumnsSSE2(rowBuffer, pass.xIndexes.constData(), pass.xWeights.constData(), dst, pass.dstWidth);
+#else
+        blendRowsScalar(row0, row0 + pass.srcStride, pass.yWeights[y], rowBuffer, rowSize);
+        blendColumnsScalar(rowBuffer, pass.xIndexes.constData(), pass.xWeights.constData(), dst, pass.dstWidth);
+#endif
+    }
+}
+
+void FrameScaler::finishStripe()
+{
+    finishSemaphore.release();
+}
+
+int FrameScaler::getPassNum()
+{
+    return passes.size();
+}
+
+int FrameScaler::getThreadNum()
+{
+    return threadNum;
+}
+
+void FrameScaler::getOutputSize(int width, int height, int scale, int maxWidth, int maxHeight, int &outputWidth, int &outputHeight)
+{
+    outputWidth = width;
+    outputHeight = height;
+
+    if (scale > 0 && scale < 100) {
+        outputWidth = width * scale / 100;
+        outputHeight = height * scale / 100;
+    }
+
+    if (maxWidth > 0 && outputWidth > maxWidth) {
+        outputHeight = (qint64) outputHeight * maxWidth / outputWidth;
+        outputWidth = maxWidth;
+    }
+
+    if (maxHeight > 0 && outputHeight > maxHeight) {
+        outputWidth = (qint64) outputWidth * maxHeight / outputHeight;
+        outputHeight = maxHeight;
+    }
+
+    // YUV 4:2:0 need even size.
+    outputWidth = std::max(outputWidth & ~1, 2);
+    outputHeight = std::max(outputHeight & ~1, 2);
+}
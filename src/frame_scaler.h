@@ -0,0 +1,119 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMESCALER_H
+#define FRAMESCALER_H
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QVector>
+
+class FrameScaler;
+
+// Scale output rows [startRow, endRow) of one pass in thread pool.
+class ScaleTask : public QRunnable
+{
+public:
+    ScaleTask(FrameScaler *scaler, int rowBufferSize);
+
+    void setStripe(int pass, int startRow, int endRow);
+    void run();
+
+private:
+    FrameScaler *scaler;
+    int pass;
+    int startRow;
+    int endRow;
+
+    // Vertical blended row of bilinear pass.
+    QVector<unsigned char> rowBuffer;
+};
+
+// Downscale BGRA frames.
+// Frame is halved with 2x2 box filter while it's still at least twice bigger than output,
+// remaining ratio is done with bilinear filter, so we never skip source pixels.
+// Every pass is split into horizontal stripes that scaled in parallel,
+// SSE2 kernels return exactly same result as scalar ones.
+
+class FrameScaler
+{
+public:
+    static const int STRIPE_MIN_ROWS;
+
+    FrameScaler();
+    ~FrameScaler();
+
+    // Output size must not bigger than input, all buffers are allocated here.
+    bool init(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+    void scale(const unsigned char *src, int srcStride, unsigned char *dst, int dstStride);
+
+    int getPassNum();
+    int getThreadNum();
+
+    void scaleStripe(int pass, int startRow, int endRow, unsigned char *rowBuffer);
+    void finishStripe();
+
+    // Fit width x height into (width * scale / 100) and maxWidth x maxHeight box, keep aspect ratio and even size.
+    // Zero maxWidth or maxHeight means no limit.
+    static void getOutputSize(int width, int height, int scale, int maxWidth, int maxHeight, int &outputWidth, int &outputHeight);
+
+private:
+    struct ScalePass {
+        int srcWidth;
+        int srcHeight;
+        int dstWidth;
+        int dstHeight;
+        bool isHalve;
+
+        const unsigned char *src;
+        int srcStride;
+        unsigned char *dst;
+        int dstStride;
+
+        // Bilinear pass: first source column/row and 7 bits weight of second one.
+        QVector<int> xIndexes;
+        QVector<short> xWeights;
+        QVector<int> yIndexes;
+        QVector<int> yWeights;
+    };
+
+    void initBilinear(ScalePass &pass);
+    void bilinearRows(ScalePass &pass, int startRow, int endRow, unsigned char *rowBuffer);
+
+    QVector<ScalePass> passes;
+
+    // Intermediate frames between passes.
+    QVector<QVector<unsigned char> > buffers;
+
+    // Row buffer of stripe that scaled in caller thread.
+    QVector<unsigned char> rowBuffer;
+
+    QThreadPool threadPool;
+    QVector<ScaleTask*> tasks;
+    QSemaphore finishSemaphore;
+    int threadNum;
+};
+
+#endif
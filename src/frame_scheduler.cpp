@@ -0,0 +1,84 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <time.h>
+#include "frame_scheduler.h"
+
+static const qint64 NSEC_PER_SEC = 1000000000LL;
+
+FrameScheduler::FrameScheduler()
+{
+    startTime = 0;
+    frameInterval = 0;
+    frameCounter = 0;
+    missedFrames = 0;
+}
+
+void FrameScheduler::start(int frameRate)
+{
+    startTime = getMonotonicTime();
+    frameInterval = NSEC_PER_SEC / frameRate;
+    frameCounter = 0;
+    missedFrames = 0;
+}
+
+qint64 FrameScheduler::waitNextFrame()
+{
+    qint64 deadline = startTime + frameCounter * frameInterval;
+
+    struct timespec deadlineSpec;
+    deadlineSpec.tv_sec = deadline / NSEC_PER_SEC;
+    deadlineSpec.tv_nsec = deadline % NSEC_PER_SEC;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadlineSpec, NULL) == EINTR) {
+    }
+
+    qint64 now = getMonotonicTime() - startTime;
+
+    // Skip deadlines we already missed, next deadline is always in future.
+    qint64 nextCounter = now / frameInterval + 1;
+    if (nextCounter > frameCounter + 1) {
+        missedFrames += nextCounter - frameCounter - 1;
+    }
+    frameCounter = nextCounter;
+
+    return now;
+}
+
+qint64 FrameScheduler::getStartTime()
+{
+    return startTime;
+}
+
+qint64 FrameScheduler::getMissedFrames()
+{
+    return missedFrames;
+}
+
+qint64 FrameScheduler::getMonotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
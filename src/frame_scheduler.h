@@ -0,0 +1,54 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QtGlobal>
+
+// Wake up at absolute CLOCK_MONOTONIC deadlines (start + n * interval),
+// so sleep error never accumulate. If we wake up too late and miss some deadlines,
+// jump to next deadline on grid instead of capture burst of frames.
+class FrameScheduler
+{
+public:
+    FrameScheduler();
+
+    void start(int frameRate);
+
+    // Sleep until next deadline, return wake up time (nanoseconds since start).
+    qint64 waitNextFrame();
+
+    qint64 getStartTime();
+    qint64 getMissedFrames();
+
+    static qint64 getMonotonicTime();
+
+private:
+    qint64 startTime;
+    qint64 frameInterval;
+    qint64 frameCounter;
+    qint64 missedFrames;
+};
+
+#endif
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QMutexLocker>
+#include <QThread>
+#include <string.h>
+#include "gif_encoder.h"
+
+const int GifEncoder::PENDING_FRAMES_PER_THREAD = 2;
+
+// GIF delay is hundredths of a second, round both ends so error won't accumulate.
+// Most viewers treat delay less than 2 as 10, so clamp it.
+static int getDelay(qint64 startTime, qint64 endTime)
+{
+    const qint64 unit = 10000000;
+
+    return qMax(2, (int) ((endTime + unit / 2) / unit - (startTime + unit / 2) / unit));
+}
+
+GifEncodeTask::GifEncodeTask(GifEncoder *e, qint64 s, int rx, int ry, int rw, int rh, bool transparency)
+{
+    encoder = e;
+    sequence = s;
+    x = rx;
+    y = ry;
+    width = rw;
+    height = rh;
+    hasTransparency = transparency;
+
+    pixels.resize(width * height * 4);
+}
+
+unsigned char* GifEncodeTask::getPixels()
+{
+    return pixels.data();
+}
+
+void GifEncodeTask::run()
+{
+    GifFrame frame;
+    GifWriter::encodeFrame(pixels.constData(), width * 4, x, y, width, height, hasTransparency, frame);
+
+    // Pixels aren't needed anymore, release before wait lock.
+    pixels.clear();
+    pixels.squeeze();
+
+    encoder->finishTask(sequence, frame);
+}
+
+GifEncoder::GifEncoder(GifWriter *w)
+{
+    writer = w;
+    nextSequence = 0;
+    writeSequence = 0;
+
+    threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+GifEncoder::~GifEncoder()
+{
+    threadPool.waitForDone();
+}
+
+bool GifEncoder::addFrame(const unsigned char *image, const unsigned char *previous, int stride, int width, int height, qint64 timestamp)
+{
+    int x = 0, y = 0, w = width, h = height;
+    if (previous && !GifWriter::findChangedRect(image, previous, stride, width, height, x, y, w, h)) {
+        return false;
+    }
+
+    // Copy changed area, capture alpha is undefined, so mark opaque pixels with 0xFF
+    // and unchanged pixels with zero alpha for transparent.
+    GifEncodeTask *task = new GifEncodeTask(this, nextSequence, x, y, w, h, previous != NULL);
+    quint32 *output = (quint32 *) task->getPixels();
+    for (int row = y; row < y + h; row++) {
+        const quint32 *imageRow = (const quint32 *) (image + row * stride) + x;
+        if (previous) {
+            const quint32 *previousRow = (const quint32 *) (previous + row * stride) + x;
+            for (int column = 0; column < w; column++) {
+                output[column] = ((imageRow[column] ^ previousRow[column]) & GifWriter::RGB_MASK) == 0 ? 0 : imageRow[column] | 0xFF000000;
+            }
+        } else {
+            for (int column = 0; column < w; column++) {
+                output[column] = imageRow[column] | 0xFF000000;
+            }
+        }
+        output += w;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        timestamps.append(timestamp);
+        nextSequence++;
+    }
+    threadPool.start(task);
+
+    // Limit frames in flight, so slow encoding use bounded memory, and write frames already done.
+    writeFrames(threadPool.maxThreadCount() * PENDING_FRAMES_PER_THREAD, -1);
+
+    return true;
+}
+
+void GifEncoder::finish(qint64 endTime)
+{
+    writeFrames(0, endTime);
+}
+
+void GifEncoder::finishTask(qint64 sequence, const GifFrame &frame)
+{
+    QMutexLocker locker(&mutex);
+    finishedFrames.insert(sequence, frame);
+    taskFinished.wakeAll();
+}
+
+int GifEncoder::getThreadNum()
+{
+    return threadPool.maxThreadCount();
+}
+
+void GifEncoder::writeFrames(qint64 maxPendingFrames, qint64 endTime)
+{
+    QMutexLocker locker(&mutex);
+    while (writeSequence < nextSequence) {
+        // Delay of frame need timestamp of next frame, last frame only can be written at finish.
+        bool hasEndTime = writeSequence + 1 < nextSequence || endTime >= 0;
+        if (hasEndTime && finishedFrames.contains(writeSequence)) {
+            GifFrame frame = finishedFrames.take(writeSequence);
+            qint64 startTime = timestamps.takeFirst();
+            qint64 frameEndTime = timestamps.isEmpty() ? qMax(endTime, startTime) : timestamps.first();
+            writeSequence++;
+
+            // Don't block workers while writing file.
+            locker.unlock();
+            writer->writeFrame(frame, getDelay(startTime, frameEndTime));
+            locker.relock();
+        } else if (nextSequence - writeSequence > maxPendingFrames) {
+            taskFinished.wait(&mutex);
+        } else {
+            break;
+        }
+    }
+}
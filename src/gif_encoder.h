@@ -0,0 +1,95 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GIFENCODER_H
+#define GIFENCODER_H
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMap>
+#include <QList>
+#include <QVector>
+#include "gif_writer.h"
+
+class GifEncoder;
+
+// Quantize and compress one frame in thread pool.
+class GifEncodeTask : public QRunnable
+{
+public:
+    GifEncodeTask(GifEncoder *encoder, qint64 sequence, int x, int y, int width, int height, bool hasTransparency);
+
+    unsigned char* getPixels();
+    void run();
+
+private:
+    GifEncoder *encoder;
+    qint64 sequence;
+    int x;
+    int y;
+    int width;
+    int height;
+    bool hasTransparency;
+
+    // Own copy of changed area, so pipeline frame can be recycled at once.
+    QVector<unsigned char> pixels;
+};
+
+// Encode GIF frames in parallel, palette and LZW of every frame are independent after delta encoding.
+// Finished frames wait in reorder buffer, and are written in capture order by thread that add frames.
+class GifEncoder
+{
+public:
+    static const int PENDING_FRAMES_PER_THREAD;
+
+    GifEncoder(GifWriter *writer);
+    ~GifEncoder();
+
+    // Previous is last frame added, or NULL for first frame, return false if frame is same as previous one.
+    bool addFrame(const unsigned char *image, const unsigned char *previous, int stride, int width, int height, qint64 timestamp);
+
+    // Write all frames, last frame display until endTime (nanoseconds).
+    void finish(qint64 endTime);
+
+    void finishTask(qint64 sequence, const GifFrame &frame);
+    int getThreadNum();
+
+private:
+    void writeFrames(qint64 maxPendingFrames, qint64 endTime);
+
+    GifWriter *writer;
+    QThreadPool threadPool;
+
+    QMutex mutex;
+    QWaitCondition taskFinished;
+    QMap<qint64, GifFrame> finishedFrames;
+
+    // Timestamps of frames not written yet, first one is frame of writeSequence.
+    QList<qint64> timestamps;
+    qint64 nextSequence;
+    qint64 writeSequence;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QVector>
+#include <string.h>
+#include "gif_writer.h"
+#include "color_quantizer.h"
+#include "lzw_encoder.h"
+
+const quint32 GifWriter::RGB_MASK = 0x00FFFFFF;
+
+static bool isSameRow(const unsigned char *image, const unsigned char *previous, int width)
+{
+    // Most unchanged rows are also same in alpha, memcmp is fastest for them.
+    if (memcmp(image, previous, width * 4) == 0) {
+        return true;
+    }
+
+    const quint32 *imageRow = (const quint32 *) image;
+    const quint32 *previousRow = (const quint32 *) previous;
+    for (int column = 0; column < width; column++) {
+        if ((imageRow[column] ^ previousRow[column]) & GifWriter::RGB_MASK) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void putShort(QByteArray &buffer, int value)
+{
+    // GIF use little endian.
+    buffer.append((char) (value & 0xFF));
+    buffer.append((char) ((value >> 8) & 0xFF));
+}
+
+GifWriter::GifWriter(QIODevice *d)
+{
+    device = d;
+}
+
+bool GifWriter::writeHeader(int width, int height)
+{
+    QByteArray buffer;
+    buffer.append("GIF89a", 6);
+
+    // Logical screen descriptor without global color table, every frame has own palette.
+    putShort(buffer, width);
+    putShort(buffer, height);
+    buffer.append((char) 0x70);
+    buffer.append((char) 0);
+    buffer.append((char) 0);
+
+    // Netscape application extension, loop forever.
+    buffer.append((char) 0x21);
+    buffer.append((char) 0xFF);
+    buffer.append((char) 11);
+    buffer.append("NETSCAPE2.0", 11);
+    buffer.append((char) 3);
+    buffer.append((char) 1);
+    putShort(buffer, 0);
+    buffer.append((char) 0);
+
+    return writeBuffer(buffer);
+}
+
+bool GifWriter::writeFrame(const GifFrame &frame, int delay)
+{
+    QByteArray buffer;
+
+    // Graphic control extension, keep frame when next frame draw over it.
+    buffer.append((char) 0x21);
+    buffer.append((char) 0xF9);
+    buffer.append((char) 4);
+    buffer.append((char) ((1 << 2) | (frame.transparentIndex >= 0 ? 1 : 0)));
+    putShort(buffer, delay);
+    buffer.append((char) (frame.transparentIndex >= 0 ? frame.transparentIndex : 0));
+    buffer.append((char) 0);
+
+    // Local color table size must be power of 2, at least 2 colors.
+    int colorNum = frame.palette.size() / 3;
+    int tableBits = 1;
+    while ((1 << tableBits) < colorNum) {
+        tableBits++;
+    }
+
+    // Image descriptor.
+    buffer.append((char) 0x2C);
+    putShort(buffer, frame.x);
+    putShort(buffer, frame.y);
+    putShort(buffer, frame.width);
+    putShort(buffer, frame.height);
+    buffer.append((char) (0x80 | (tableBits - 1)));
+
+    buffer.append(frame.palette);
+    for (int i = colorNum; i < (1 << tableBits); i++) {
+        buffer.append((char) 0);
+        buffer.append((char) 0);
+        buffer.append((char) 0);
+    }
+
+    return writeBuffer(buffer) && writeBuffer(frame.data);
+}
+
+bool GifWriter::writeTrailer()
+{
+    QByteArray buffer;
+    buffer.append((char) 0x3B);
+
+    return writeBuffer(buffer);
+}
+
+void GifWriter::encodeFrame(const unsigned char *image, int stride, int x, int y, int width, int height, bool hasTransparency, GifFrame &frame)
+{
+    // Last palette entry is reserved for transparent pixel.
+    ColorQuantizer quantizer;
+    int maxColors = hasTransparency ? ColorQuantizer::MAX_COLORS - 1 : ColorQuantizer::MAX_COLORS;
+    int colorNum = quantizer.buildPalette(image, stride, width, height, maxColors, hasTransparency);
+
+    frame.x = x;
+    frame.y = y;
+    frame.width = width;
+    frame.height = height;
+    frame.palette = QByteArray((const char *) quantizer.getPalette(), colorNum * 3);
+    frame.transparentIndex = -1;
+    if (hasTransparency) {
+        frame.transparentIndex = colorNum;
+        frame.palette.append("\0\0\0", 3);
+        colorNum++;
+    }
+
+    QVector<unsigned char> indexes(width * height);
+    quantizer.mapPixels(image, stride, width, height, frame.transparentIndex, indexes.data());
+
+    // LZW minimum code size is 2 even for 2 colors palette.
+    int minCodeSize = 2;
+    while ((1 << minCodeSize) < colorNum) {
+        minCodeSize++;
+    }
+
+    LzwEncoder encoder;
+    frame.data.clear();
+    encoder.encode(indexes.constData(), indexes.size(), minCodeSize, frame.data);
+}
+
+bool GifWriter::findChangedRect(const unsigned char *image, const unsigned char *previous, int stride, int width, int height,
+                                int &x, int &y, int &w, int &h)
+{
+    int top = 0;
+    while (top < height && isSameRow(image + top * stride, previous + top * stride, width)) {
+        top++;
+    }
+    if (top == height) {
+        return false;
+    }
+
+    int bottom = height - 1;
+    while (bottom > top && isSameRow(image + bottom * stride, previous + bottom * stride, width)) {
+        bottom--;
+    }
+
+    // Shrink left and right edge with rows in range, stop scan row once it can't extend edges.
+    int left = width;
+    int right = -1;
+    for (int row = top; row <= bottom; row++) {
+        const quint32 *imageRow = (const quint32 *) (image + row * stride);
+        const quint32 *previousRow = (const quint32 *) (previous + row * stride);
+
+        for (int column = 0; column < left; column++) {
+            if ((imageRow[column] ^ previousRow[column]) & RGB_MASK) {
+                left = column;
+                break;
+            }
+        }
+        for (int column = width - 1; column > right; column--) {
+            if ((imageRow[column] ^ previousRow[column]) & RGB_MASK) {
+                right = column;
+                break;
+            }
+        }
+    }
+
+    x = left;
+    y = top;
+    w = right - left + 1;
+    h = bottom - top + 1;
+
+    return true;
+}
+
+bool GifWriter::writeBuffer(const QByteArray &buffer)
+{
+    return device->write(buffer) == buffer.size();
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GIFWRITER_H
+#define GIFWRITER_H
+
+#include <QIODevice>
+#include <QByteArray>
+
+// Encoded GIF frame, frame can cover part of screen.
+struct GifFrame {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    // RGB triples of local color table.
+    QByteArray palette;
+
+    // Palette index that means transparent pixel, -1 if no transparent.
+    int transparentIndex;
+
+    // LZW data, include minimum code size and sub-blocks.
+    QByteArray data;
+};
+
+// Streaming GIF89a writer, frame is written to device once it's encoded,
+// only file header and trailer are needed to make a valid animation.
+class GifWriter
+{
+public:
+    // X server don't define alpha (padding) byte of 24-bit depth visual, only compare RGB bytes.
+    static const quint32 RGB_MASK;
+
+    GifWriter(QIODevice *device);
+
+    bool writeHeader(int width, int height);
+
+    // Delay is hundredths of a second, display time of this frame.
+    bool writeFrame(const GifFrame &frame, int delay);
+    bool writeTrailer();
+
+    // Encode BGRA image to GIF frame with local palette, frame is placed at (x, y) of screen.
+    // If hasTransparency is true, pixels with zero alpha are transparent.
+    static void encodeFrame(const unsigned char *image, int stride, int x, int y, int width, int height, bool hasTransparency, GifFrame &frame);
+
+    // Bounding box of pixels different between two BGRA images (alpha is ignored), return false if images are same.
+    static bool findChangedRect(const unsigned char *image, const unsigned char *previous, int stride, int width, int height,
+                                int &x, int &y, int &w, int &h);
+
+private:
+    bool writeBuffer(const QByteArray &buffer);
+
+    QIODevice *device;
+};
+
+#endif
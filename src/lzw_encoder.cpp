@@ -0,0 +1,154 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "lzw_encoder.h"
+
+const int LzwEncoder::MAX_CODE_SIZE = 12;
+const int LzwEncoder::HASH_SIZE = 5003;
+
+LzwEncoder::LzwEncoder()
+{
+    hashKeys.resize(HASH_SIZE);
+    hashCodes.resize(HASH_SIZE);
+
+    output = NULL;
+    blockSize = 0;
+    bitBuffer = 0;
+    bitCount = 0;
+    codeSize = 0;
+}
+
+void LzwEncoder::encode(const unsigned char *indexes, int size, int minCodeSize, QByteArray &buffer)
+{
+    output = &buffer;
+    output->append((char) minCodeSize);
+
+    blockSize = 0;
+    bitBuffer = 0;
+    bitCount = 0;
+
+    int clearCode = 1 << minCodeSize;
+    int endCode = clearCode + 1;
+    int maxCode = 1 << MAX_CODE_SIZE;
+
+    codeSize = minCodeSize + 1;
+    int nextCode = endCode + 1;
+    resetTable();
+    writeCode(clearCode);
+
+    if (size > 0) {
+        int prefix = indexes[0];
+        for (int i = 1; i < size; i++) {
+            int index = indexes[i];
+            int key = (prefix << 8) | index;
+
+            // Find string in table, probe step never be zero.
+            int hash = ((index << 4) ^ prefix) % HASH_SIZE;
+            int step = hash == 0 ? 1 : HASH_SIZE - hash;
+            while (hashKeys[hash] >= 0 && hashKeys[hash] != key) {
+                hash -= step;
+                if (hash < 0) {
+                    hash += HASH_SIZE;
+                }
+            }
+
+            if (hashKeys[hash] == key) {
+                prefix = hashCodes[hash];
+                continue;
+            }
+
+            writeCode(prefix);
+            prefix = index;
+
+            // Decoder add same code after read next code, so code size grow when code reach current limit.
+            if (nextCode < maxCode) {
+                hashKeys[hash] = key;
+                hashCodes[hash] = nextCode;
+                nextCode++;
+                if (nextCode > (1 << codeSize) && codeSize < MAX_CODE_SIZE) {
+                    codeSize++;
+                }
+            } else {
+                writeCode(clearCode);
+                resetTable();
+                codeSize = minCodeSize + 1;
+                nextCode = endCode + 1;
+            }
+        }
+
+        writeCode(prefix);
+    }
+
+    writeCode(endCode);
+    flushBits();
+    flushBlock();
+
+    // Block terminator.
+    output->append((char) 0);
+    output = NULL;
+}
+
+void LzwEncoder::resetTable()
+{
+    memset(hashKeys.data(), 0xFF, HASH_SIZE * sizeof(int));
+}
+
+void LzwEncoder::writeCode(int code)
+{
+    // GIF pack codes from least significant bit.
+    bitBuffer |= (quint32) code << bitCount;
+    bitCount += codeSize;
+
+    while (bitCount >= 8) {
+        block[blockSize++] = bitBuffer & 0xFF;
+        bitBuffer >>= 8;
+        bitCount -= 8;
+
+        if (blockSize == 255) {
+            flushBlock();
+        }
+    }
+}
+
+void LzwEncoder::flushBits()
+{
+    if (bitCount > 0) {
+        block[blockSize++] = bitBuffer & 0xFF;
+        bitBuffer = 0;
+        bitCount = 0;
+
+        if (blockSize == 255) {
+            flushBlock();
+        }
+    }
+}
+
+void LzwEncoder::flushBlock()
+{
+    if (blockSize > 0) {
+        output->append((char) blockSize);
+        output->append((const char *) block, blockSize);
+        blockSize = 0;
+    }
+}
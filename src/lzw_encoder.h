@@ -0,0 +1,61 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LZWENCODER_H
+#define LZWENCODER_H
+
+#include <QVector>
+#include <QByteArray>
+
+// Variable length LZW encoder of GIF image data.
+// Output start with minimum code size byte, then data sub-blocks and block terminator.
+class LzwEncoder
+{
+public:
+    static const int MAX_CODE_SIZE;
+    static const int HASH_SIZE;
+
+    LzwEncoder();
+
+    void encode(const unsigned char *indexes, int size, int minCodeSize, QByteArray &output);
+
+private:
+    void resetTable();
+    void writeCode(int code);
+    void flushBits();
+    void flushBlock();
+
+    // Open addressing hash table, key is (prefix code << 8 | next index).
+    QVector<int> hashKeys;
+    QVector<short> hashCodes;
+
+    QByteArray *output;
+    unsigned char block[256];
+    int blockSize;
+
+    quint32 bitBuffer;
+    int bitCount;
+    int codeSize;
+};
+
+#endif
@@ -41,7 +41,7 @@ int main(int argc, char *argv[])
 
         MainWindow window;
 
-        QObject::connect(&app, &DApplication::newInstanceStarted, &window, &MainWindow::stopRecord);
+        QObject::connect(&app, &DApplication::newInstanceStarted, &window, &MainWindow::handleNewInstance);
 
         window.showFullScreen();
 
@@ -92,18 +92,16 @@ void MainWindow::initAttributes()
     flashTrayIconCounter = 0;
 
     selectAreaName = "";
+    selectWindow = XCB_NONE;
 
-    // Get all windows geometry.
-    // Below code must execute before `window.showFullscreen,
-    // otherwise deepin-screen-recorder window will add in window lists.
+    // Get all windows geometry, and keep them update when windows open, move or close.
+    // Ignore deepin-screen-recorder window, otherwise it will add in window lists after `window.showFullscreen`.
     windowManager = new WindowManager();
-    QList<xcb_window_t> windows = windowManager->getWindows();
+    recordProcess.setWindowManager(windowManager);
     rootWindowRect = windowManager->getRootWindowRect();
-
-    for (int i = 0; i < windows.length(); i++) {
-        windowRects.append(windowManager->adjustRectInScreenArea(windowManager->getWindowRect(windows[i])));
-        windowNames.append(windowManager->getWindowClass(windows[i]));
-    }
+    windowManager->startWatchWindows(this->winId());
+    connect(windowManager, SIGNAL(windowsChanged()), this, SLOT(updateWindows()));
+    updateWindows();
 
     recordButtonLayout = new QVBoxLayout();
     setLayout(recordButtonLayout);
@@ -143,7 +141,7 @@ void MainWindow::initResource()
     setDragCursor();
 }
 
-void MainWindow::paintEvent(QPaintEvent *)
+void MainWindow::paintEvent(QPaintEvent *event)
 {
     // Just use for debug.
     // repaintCounter++;
@@ -162,7 +160,7 @@ void MainWindow::paintEvent(QPaintEvent *)
         painter.setOpacity(0.2);
 
         painter.setClipping(true);
-        painter.setClipRegion(QRegion(backgroundRect).subtracted(QRegion(frameRect)));
+        painter.setClipRegion(QRegion(backgroundRect).subtracted(QRegion(frameRect)).intersected(event->region()));
         painter.drawRect(backgroundRect);
 
         // Reset clip.
@@ -233,6 +231,7 @@ bool MainWindow::eventFilter(QObject *, QEvent *event)
 
         if (keyEvent->key() == Qt::Key_Escape) {
             if (recordButtonStatus != RECORD_BUTTON_RECORDING) {
+                recordProcess.cancelRecord();
                 QApplication::quit();
             }
         }
@@ -332,18 +331,11 @@ bool MainWindow::eventFilter(QObject *, QEvent *event)
             // Record select area name with window name if just click (no drag).
             if (!isFirstDrag) {
                 QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
-                for (int i = 0; i < windowRects.length(); i++) {
-                    int wx = windowRects[i].x;
-                    int wy = windowRects[i].y;
-                    int ww = windowRects[i].width;
-                    int wh = windowRects[i].height;
-                    int ex = mouseEvent->x();
-                    int ey = mouseEvent->y();
-                    if (ex > wx && ex < wx + ww && ey > wy && ey < wy + wh) {
-                        selectAreaName = windowNames[i];
-
-                        break;
-                    }
+                int i = windowIndex.find(mouseEvent->x(), mouseEvent->y());
+                if (i >= 0) {
+                    selectAreaName = windowNames[i];
+                    selectWindow = windowIds[i];
+                    selectWindowRect = windowRects[i];
                 }
 
             } else {
@@ -438,44 +430,114 @@ bool MainWindow::eventFilter(QObject *, QEvent *event)
                 needRepaint = true;
             }
         } else {
-            for (int i = 0; i < windowRects.length(); i++) {
-                int wx = windowRects[i].x;
-                int wy = windowRects[i].y;
-                int ww = windowRects[i].width;
-                int wh = windowRects[i].height;
-                int ex = mouseEvent->x();
-                int ey = mouseEvent->y();
-                if (ex > wx && ex < wx + ww && ey > wy && ey < wy + wh) {
-                    recordX = wx;
-                    recordY = wy;
-                    recordWidth = ww;
-                    recordHeight = wh;
+            int i = windowIndex.find(mouseEvent->x(), mouseEvent->y());
+            if (i >= 0) {
+                const WindowRect &rect = windowRects[i];
 
-                    needRepaint = true;
+                // Don't repaint if cursor still in same window.
+                if (recordX != rect.x || recordY != rect.y || recordWidth != rect.width || recordHeight != rect.height) {
+                    recordX = rect.x;
+                    recordY = rect.y;
+                    recordWidth = rect.width;
+                    recordHeight = rect.height;
 
-                    break;
+                    needRepaint = true;
                 }
             }
         }
     }
 
-    // Use flag instead call `repaint` directly,
-    // to avoid repaint many times in one event function.
+    // Use flag instead call `update` directly,
+    // to avoid compute dirty region many times in one event function.
     if (needRepaint) {
-        repaint();
+        updateSelection();
     }
 
     return false;
 }
 
+void MainWindow::updateWindows()
+{
+    QList<WindowInfo> windows = windowManager->getWindowSnapshot();
+    QSet<xcb_window_t> changedWindows = windowManager->getChangedWindows();
+    QSet<xcb_window_t> treeChangedWindows = windowManager->getTreeChangedWindows();
+
+    // Drop cache of closed or hidden windows.
+    QSet<xcb_window_t> listedWindows;
+    foreach (auto info, windows) {
+        listedWindows.insert(info.window);
+    }
+    QMutableHashIterator<xcb_window_t, SubWindowCache> iter(subWindowCaches);
+    while (iter.hasNext()) {
+        iter.next();
+        if (!listedWindows.contains(iter.key())) {
+            iter.remove();
+        }
+    }
+
+    // Only read sub windows of new, resized, reparented windows and windows that child windows changed,
+    // window that only moved keep same sub windows, just move them together.
+    QList<WindowInfo> expandWindows;
+    foreach (auto info, windows) {
+        if (!subWindowCaches.contains(info.window) || treeChangedWindows.contains(info.window)) {
+            expandWindows.append(info);
+        } else if (changedWindows.contains(info.window)) {
+            SubWindowCache &cache = subWindowCaches[info.window];
+            if (info.rect.width != cache.rect.width || info.rect.height != cache.rect.height) {
+                expandWindows.append(info);
+            } else if (info.rect.x != cache.rect.x || info.rect.y != cache.rect.y) {
+                int offsetX = info.rect.x - cache.rect.x;
+                int offsetY = info.rect.y - cache.rect.y;
+                for (int i = 0; i < cache.subWindows.size(); i++) {
+                    cache.subWindows[i].rect.x += offsetX;
+                    cache.subWindows[i].rect.y += offsetY;
+                }
+                cache.rect = info.rect;
+            }
+        }
+    }
+
+    // Sub windows smaller than record area limit are not useful to snap.
+    if (!expandWindows.isEmpty()) {
+        QHash<xcb_window_t, QList<WindowInfo> > subWindows = windowManager->getSubWindows(expandWindows, RECORD_MIN_SIZE);
+        foreach (auto info, expandWindows) {
+            SubWindowCache cache;
+            cache.rect = info.rect;
+            cache.subWindows = subWindows.value(info.window);
+            subWindowCaches.insert(info.window, cache);
+        }
+    }
+
+    // Sub windows are above their top level window, so list keep sorted from top to bottom.
+    windowRects.clear();
+    windowNames.clear();
+    windowIds.clear();
+    foreach (auto info, windows) {
+        foreach (auto subWindow, subWindowCaches[info.window].subWindows) {
+            windowRects.append(windowManager->adjustRectInScreenArea(subWindow.rect, rootWindowRect));
+            windowNames.append(subWindow.className);
+            windowIds.append(subWindow.window);
+        }
+
+        windowRects.append(windowManager->adjustRectInScreenArea(info.rect, rootWindowRect));
+        windowNames.append(info.className);
+        windowIds.append(info.window);
+    }
+
+    windowIndex.build(windowRects, rootWindowRect.width, rootWindowRect.height);
+}
+
 void MainWindow::startRecord()
 {
+    // Record area is fixed now, don't need window list anymore.
+    windowManager->stopWatchWindows();
+
     Utils::clearBlur(windowManager, this->winId());
     recordButtonStatus = RECORD_BUTTON_RECORDING;
 
     resetCursor();
 
-    repaint();
+    update();
 
     trayIcon->show();
 
@@ -667,17 +729,42 @@ void MainWindow::stopRecord()
     }
 }
 
+void MainWindow::handleNewInstance()
+{
+    // In instant replay mode, launch again save last seconds and keep recording.
+    if (recordButtonStatus == RECORD_BUTTON_RECORDING && recordProcess.isReplayMode()) {
+        recordProcess.saveReplay();
+    } else {
+        stopRecord();
+    }
+}
+
 void MainWindow::startCountdown()
 {
+    // Nothing to record, let user select area again.
+    if (!recordProcess.setRecordInfo(recordX, recordY, recordWidth, recordHeight, selectAreaName)) {
+        return;
+    }
+
     recordButtonStatus = RECORD_BUTTON_WAIT;
 
-    recordProcess.setRecordInfo(recordX, recordY, recordWidth, recordHeight, selectAreaName, rootWindowRect.width, rootWindowRect.height);
+    // Only follow clicked window if record area is not moved or resized after click.
+    if (selectWindow != XCB_NONE &&
+        recordX == selectWindowRect.x && recordY == selectWindowRect.y &&
+        recordWidth == selectWindowRect.width && recordHeight == selectWindowRect.height) {
+        recordProcess.setRecordWindow(selectWindow);
+    } else {
+        recordProcess.setRecordWindow(XCB_NONE);
+    }
     if (recordOptionPanel->isSaveAsGif()) {
         recordProcess.setRecordType(RecordProcess::RECORD_TYPE_GIF);
     } else {
         recordProcess.setRecordType(RecordProcess::RECORD_TYPE_VIDEO);
     }
 
+    // Start encoder and capture now, they are ready when countdown finished.
+    recordProcess.prepareRecord();
+
     resetCursor();
 
     hideRecordButton();
@@ -699,7 +786,53 @@ void MainWindow::startCountdown()
 
     Utils::passInputEvent(this->winId());
 
-    repaint();
+    update();
+}
+
+QRegion MainWindow::getSelectionRegion()
+{
+    QRegion region;
+    QRect frameRect(recordX, recordY, recordWidth, recordHeight);
+
+    // Frame pen is 2 pixels, and frame is moved inside screen.
+    region += QRegion(frameRect.adjusted(-2, -2, 2, 2)).subtracted(QRegion(frameRect.adjusted(2, 2, -2, -2)));
+
+    // Drag points, big image cover small image.
+    int pointSize = std::max(resizeHandleBigImg.width(), resizeHandleBigImg.height());
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (i != 1 || j != 1) {
+                region += QRect(recordX - DRAG_POINT_RADIUS + recordWidth * i / 2,
+                                recordY - DRAG_POINT_RADIUS + recordHeight * j / 2,
+                                pointSize, pointSize);
+            }
+        }
+    }
+
+    // Record panel.
+    if (recordButtonStatus == RECORD_BUTTON_NORMAL && recordButton->isVisible()) {
+        region += recordButton->geometry();
+        region += recordOptionPanel->geometry();
+    }
+
+    return region;
+}
+
+void MainWindow::updateSelection()
+{
+    QRect frameRect(recordX, recordY, recordWidth, recordHeight);
+    QRegion selectionRegion = getSelectionRegion();
+
+    if (paintedFrameRect.isEmpty() || frameRect.isEmpty()) {
+        // Background is dimmed or cleared in whole screen.
+        update();
+    } else {
+        // Dimmed background only change in area that inside one of old and new frame.
+        update(QRegion(paintedFrameRect).xored(QRegion(frameRect)) + paintedSelectionRegion + selectionRegion);
+    }
+
+    paintedFrameRect = frameRect;
+    paintedSelectionRegion = selectionRegion;
 }
 
 void MainWindow::showRecordButton()
@@ -23,10 +23,12 @@
 
 #include <QObject>
 #include <QPainter>
+#include <QRegion>
 #include <QWidget>
 #include <QSystemTrayIcon>
 #include <QVBoxLayout>
 #include "window_manager.h"
+#include "window_index.h"
 #include "record_process.h"
 #include "record_button.h"
 #include "record_option_panel.h"
@@ -77,7 +79,9 @@ public slots:
     void flashTrayIcon();
     void iconActivated(QSystemTrayIcon::ActivationReason reason);
     void stopRecord();
+    void handleNewInstance();
     void startCountdown();
+    void updateWindows();
     
 protected:
     bool eventFilter(QObject *object, QEvent *event);
@@ -95,9 +99,27 @@ protected:
     void hideRecordButton();
     void adjustLayout(QVBoxLayout *layout, int layoutWidth, int layoutHeight);
 
+    // Area of frame, drag points and record panel, need repaint when selection changed.
+    QRegion getSelectionRegion();
+
+    // Only repaint dirty region between last painted selection and current selection.
+    void updateSelection();
+
 private:
+    // Sub windows of top level window, and top level window rect when they are read.
+    struct SubWindowCache {
+        WindowRect rect;
+        QList<WindowInfo> subWindows;
+    };
+
     QList<WindowRect> windowRects;
     QList<QString> windowNames;
+    QList<xcb_window_t> windowIds;
+    WindowIndex windowIndex;
+    QHash<xcb_window_t, SubWindowCache> subWindowCaches;
+
+    QRect paintedFrameRect;
+    QRegion paintedSelectionRegion;
 
     QTimer* flashTrayIconTimer;
 
@@ -135,6 +157,10 @@ private:
     QImage resizeHandleSmallImg;
     
     QString selectAreaName;
+
+    // Window that clicked to select, record area is still same as its rect if user don't adjust it.
+    xcb_window_t selectWindow;
+    WindowRect selectWindowRect;
     
     QSystemTrayIcon* trayIcon;
     
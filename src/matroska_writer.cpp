@@ -0,0 +1,209 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "matroska_writer.h"
+
+const int MatroskaWriter::CLUSTER_DURATION = 5000;
+
+// EBML element ids.
+static const quint32 EBML_ID_HEADER = 0x1A45DFA3;
+static const quint32 EBML_ID_VERSION = 0x4286;
+static const quint32 EBML_ID_READ_VERSION = 0x42F7;
+static const quint32 EBML_ID_MAX_ID_LENGTH = 0x42F2;
+static const quint32 EBML_ID_MAX_SIZE_LENGTH = 0x42F3;
+static const quint32 EBML_ID_DOC_TYPE = 0x4282;
+static const quint32 EBML_ID_DOC_TYPE_VERSION = 0x4287;
+static const quint32 EBML_ID_DOC_TYPE_READ_VERSION = 0x4285;
+
+// Matroska element ids.
+static const quint32 MKV_ID_SEGMENT = 0x18538067;
+static const quint32 MKV_ID_INFO = 0x1549A966;
+static const quint32 MKV_ID_TIMECODE_SCALE = 0x2AD7B1;
+static const quint32 MKV_ID_MUXING_APP = 0x4D80;
+static const quint32 MKV_ID_WRITING_APP = 0x5741;
+static const quint32 MKV_ID_TRACKS = 0x1654AE6B;
+static const quint32 MKV_ID_TRACK_ENTRY = 0xAE;
+static const quint32 MKV_ID_TRACK_NUMBER = 0xD7;
+static const quint32 MKV_ID_TRACK_UID = 0x73C5;
+static const quint32 MKV_ID_TRACK_TYPE = 0x83;
+static const quint32 MKV_ID_FLAG_LACING = 0x9C;
+static const quint32 MKV_ID_CODEC_ID = 0x86;
+static const quint32 MKV_ID_VIDEO = 0xE0;
+static const quint32 MKV_ID_PIXEL_WIDTH = 0xB0;
+static const quint32 MKV_ID_PIXEL_HEIGHT = 0xBA;
+static const quint32 MKV_ID_COLOUR_SPACE = 0x2EB524;
+static const quint32 MKV_ID_CLUSTER = 0x1F43B675;
+static const quint32 MKV_ID_CLUSTER_TIMECODE = 0xE7;
+static const quint32 MKV_ID_SIMPLE_BLOCK = 0xA3;
+
+// Timestamps in stream are milliseconds.
+static const quint64 MKV_TIMECODE_SCALE = 1000000;
+
+static void putId(QByteArray &buffer, quint32 id)
+{
+    bool started = false;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        quint8 byte = (id >> shift) & 0xFF;
+        if (byte || started) {
+            buffer.append((char) byte);
+            started = true;
+        }
+    }
+}
+
+static void putSize(QByteArray &buffer, quint64 size)
+{
+    // Use shortest length, value with all bits set is reserved for 'unknown size'.
+    int length = 1;
+    while (length < 8 && size >= (1ULL << (7 * length)) - 1) {
+        length++;
+    }
+
+    quint64 value = size | (1ULL << (7 * length));
+    for (int i = length - 1; i >= 0; i--) {
+        buffer.append((char) ((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static void putUnknownSize(QByteArray &buffer)
+{
+    buffer.append((char) 0x01);
+    for (int i = 0; i < 7; i++) {
+        buffer.append((char) 0xFF);
+    }
+}
+
+static void putUInt(QByteArray &buffer, quint32 id, quint64 value)
+{
+    int length = 1;
+    while (length < 8 && (value >> (8 * length))) {
+        length++;
+    }
+
+    putId(buffer, id);
+    putSize(buffer, length);
+    for (int i = length - 1; i >= 0; i--) {
+        buffer.append((char) ((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static void putBinary(QByteArray &buffer, quint32 id, const QByteArray &value)
+{
+    putId(buffer, id);
+    putSize(buffer, value.size());
+    buffer.append(value);
+}
+
+static void putMaster(QByteArray &buffer, quint32 id, const QByteArray &content)
+{
+    putBinary(buffer, id, content);
+}
+
+MatroskaWriter::MatroskaWriter(QIODevice *d)
+{
+    device = d;
+    hasCluster = false;
+    clusterTime = 0;
+}
+
+bool MatroskaWriter::writeHeader(int width, int height, const char *fourcc)
+{
+    QByteArray buffer;
+
+    QByteArray ebml;
+    putUInt(ebml, EBML_ID_VERSION, 1);
+    putUInt(ebml, EBML_ID_READ_VERSION, 1);
+    putUInt(ebml, EBML_ID_MAX_ID_LENGTH, 4);
+    putUInt(ebml, EBML_ID_MAX_SIZE_LENGTH, 8);
+    putBinary(ebml, EBML_ID_DOC_TYPE, QByteArray("matroska"));
+    putUInt(ebml, EBML_ID_DOC_TYPE_VERSION, 4);
+    putUInt(ebml, EBML_ID_DOC_TYPE_READ_VERSION, 2);
+    putMaster(buffer, EBML_ID_HEADER, ebml);
+
+    // We don't know segment size when streaming.
+    putId(buffer, MKV_ID_SEGMENT);
+    putUnknownSize(buffer);
+
+    QByteArray info;
+    putUInt(info, MKV_ID_TIMECODE_SCALE, MKV_TIMECODE_SCALE);
+    putBinary(info, MKV_ID_MUXING_APP, QByteArray("deepin-screen-recorder"));
+    putBinary(info, MKV_ID_WRITING_APP, QByteArray("deepin-screen-recorder"));
+    putMaster(buffer, MKV_ID_INFO, info);
+
+    QByteArray video;
+    putUInt(video, MKV_ID_PIXEL_WIDTH, width);
+    putUInt(video, MKV_ID_PIXEL_HEIGHT, height);
+    putBinary(video, MKV_ID_COLOUR_SPACE, QByteArray(fourcc, 4));
+
+    QByteArray track;
+    putUInt(track, MKV_ID_TRACK_NUMBER, 1);
+    putUInt(track, MKV_ID_TRACK_UID, 1);
+    putUInt(track, MKV_ID_TRACK_TYPE, 1);
+    putUInt(track, MKV_ID_FLAG_LACING, 0);
+    putBinary(track, MKV_ID_CODEC_ID, QByteArray("V_UNCOMPRESSED"));
+    putMaster(track, MKV_ID_VIDEO, video);
+
+    QByteArray tracks;
+    putMaster(tracks, MKV_ID_TRACK_ENTRY, track);
+    putMaster(buffer, MKV_ID_TRACKS, tracks);
+
+    hasCluster = false;
+
+    return writeBuffer(buffer);
+}
+
+bool MatroskaWriter::writeFrame(const unsigned char *data, int size, qint64 timestamp)
+{
+    QByteArray buffer;
+    qint64 time = timestamp / (qint64) MKV_TIMECODE_SCALE;
+
+    // Block timecode is signed 16 bits relative to cluster, start new cluster before it overflow.
+    if (!hasCluster || time - clusterTime >= CLUSTER_DURATION || time < clusterTime) {
+        clusterTime = time;
+        hasCluster = true;
+
+        putId(buffer, MKV_ID_CLUSTER);
+        putUnknownSize(buffer);
+        putUInt(buffer, MKV_ID_CLUSTER_TIMECODE, clusterTime);
+    }
+
+    qint16 relativeTime = time - clusterTime;
+
+    putId(buffer, MKV_ID_SIMPLE_BLOCK);
+    putSize(buffer, size + 4);
+    buffer.append((char) 0x81);   // track number 1
+    buffer.append((char) ((relativeTime >> 8) & 0xFF));
+    buffer.append((char) (relativeTime & 0xFF));
+    buffer.append((char) 0x80);   // keyframe
+
+    if (!writeBuffer(buffer)) {
+        return false;
+    }
+
+    return device->write((const char *) data, size) == size;
+}
+
+bool MatroskaWriter::writeBuffer(const QByteArray &buffer)
+{
+    return device->write(buffer) == buffer.size();
+}
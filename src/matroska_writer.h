@@ -0,0 +1,55 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATROSKAWRITER_H
+#define MATROSKAWRITER_H
+
+#include <QIODevice>
+#include <QByteArray>
+
+// Minimal streaming Matroska muxer for one uncompressed video track.
+// We use it to pass raw frames to ffmpeg with real capture timestamps,
+// rawvideo format can't carry timestamps, so ffmpeg has to assume constant frame rate.
+class MatroskaWriter
+{
+public:
+    static const int CLUSTER_DURATION;
+
+    MatroskaWriter(QIODevice *device);
+
+    // FourCC of raw format, such as "I420".
+    bool writeHeader(int width, int height, const char *fourcc);
+
+    // Timestamp is nanoseconds, stored with millisecond precision.
+    bool writeFrame(const unsigned char *data, int size, qint64 timestamp);
+
+private:
+    bool writeBuffer(const QByteArray &buffer);
+
+    QIODevice *device;
+
+    bool hasCluster;
+    qint64 clusterTime;
+};
+
+#endif
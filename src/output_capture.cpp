@@ -0,0 +1,177 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb_aux.h>
+#include "output_capture.h"
+
+OutputCapture::OutputCapture(QObject *parent) : QThread(parent)
+{
+    conn = NULL;
+    isStopped = 0;
+
+    targetFrame = NULL;
+    targetStride = 0;
+    grabResult = false;
+    frameTime = 0;
+    needFullCopy = true;
+
+    captureWidth = 0;
+    captureHeight = 0;
+    targetX = 0;
+    targetY = 0;
+}
+
+OutputCapture::~OutputCapture()
+{
+    stop();
+
+    capture.release();
+    if (conn) {
+        xcb_disconnect(conn);
+    }
+}
+
+bool OutputCapture::init(int x, int y, int width, int height, int offsetX, int offsetY, bool useDamage)
+{
+    captureWidth = width;
+    captureHeight = height;
+    targetX = offsetX;
+    targetY = offsetY;
+
+    // NULL display name make xcb use $DISPLAY, same display as main connection.
+    int screenNum;
+    conn = xcb_connect(NULL, &screenNum);
+    if (xcb_connection_has_error(conn)) {
+        qDebug() << "Connect X server failed";
+        return false;
+    }
+
+    xcb_screen_t *screen = xcb_aux_get_screen(conn, screenNum);
+    if (!screen || !capture.init(conn, screen->root, x, y, width, height)) {
+        qDebug() << QString("Init capture of output %1x%2+%3+%4 failed").arg(width).arg(height).arg(x).arg(y);
+        return false;
+    }
+
+    if (useDamage && !capture.enableDamage()) {
+        qDebug() << QString("Enable damage capture of output %1x%2+%3+%4 failed").arg(width).arg(height).arg(x).arg(y);
+    }
+
+    start();
+
+    return true;
+}
+
+void OutputCapture::requestFrame(unsigned char *frame, int stride)
+{
+    targetFrame = frame;
+    targetStride = stride;
+    requestSemaphore.release();
+}
+
+bool OutputCapture::waitFrame()
+{
+    finishSemaphore.acquire();
+    return grabResult;
+}
+
+qint64 OutputCapture::getFrameTime()
+{
+    return frameTime;
+}
+
+bool OutputCapture::isDamageEnabled()
+{
+    return capture.isDamageEnabled();
+}
+
+const QVector<xcb_rectangle_t>& OutputCapture::getDamagedRects()
+{
+    return damagedRects;
+}
+
+void OutputCapture::stop()
+{
+    if (isRunning()) {
+        isStopped = 1;
+        requestSemaphore.release();
+        wait();
+    }
+}
+
+void OutputCapture::run()
+{
+    while (true) {
+        requestSemaphore.acquire();
+        if (isStopped.load()) {
+            break;
+        }
+
+        // Damage notify events are just hints, damaged region is fetched by capture.
+        xcb_generic_event_t *event;
+        while ((event = xcb_poll_for_event(conn)) != NULL) {
+            free(event);
+        }
+
+        const unsigned char *data = capture.grabFrame();
+        grabResult = data != NULL;
+        if (data) {
+            frameTime = capture.getFrameTime();
+
+            int stride = capture.getStride();
+            unsigned char *target = targetFrame ? targetFrame + targetY * targetStride + targetX * 4 : NULL;
+            damagedRects.clear();
+            if (!target) {
+                // Record frame miss this grab, damaged rectangles are lost.
+                needFullCopy = true;
+            } else if (capture.isDamageEnabled() && !needFullCopy) {
+                foreach (auto rect, capture.getDamagedRects()) {
+                    for (int row = rect.y; row < rect.y + rect.height; row++) {
+                        memcpy(target + row * targetStride + rect.x * 4, data + row * stride + rect.x * 4, rect.width * 4);
+                    }
+
+                    rect.x += targetX;
+                    rect.y += targetY;
+                    damagedRects.append(rect);
+                }
+            } else {
+                for (int row = 0; row < captureHeight; row++) {
+                    memcpy(target + row * targetStride, data + row * stride, captureWidth * 4);
+                }
+                needFullCopy = false;
+
+                xcb_rectangle_t rect;
+                rect.x = targetX;
+                rect.y = targetY;
+                rect.width = captureWidth;
+                rect.height = captureHeight;
+                damagedRects.append(rect);
+            }
+        }
+
+        // Semaphore release/acquire make frame data visible to waiter.
+        finishSemaphore.release();
+    }
+}
@@ -0,0 +1,87 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUTCAPTURE_H
+#define OUTPUTCAPTURE_H
+
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QVector>
+#include <xcb/xcb.h>
+#include "screen_capture.h"
+
+// Capture part of record area that show on one monitor.
+// Every output has own X connection, SHM segments and thread,
+// so X server can copy all outputs at same time and we copy them into record frame in parallel.
+class OutputCapture : public QThread
+{
+    Q_OBJECT
+
+public:
+    OutputCapture(QObject *parent = 0);
+    ~OutputCapture();
+
+    // Area (x, y, width, height) is in root window, it is copied to (offsetX, offsetY) of record frame.
+    bool init(int x, int y, int width, int height, int offsetX, int offsetY, bool useDamage);
+
+    // Grab frame and copy it into record frame, frame is NULL if grabbed frame should be dropped.
+    // Call waitFrame to wait copy finish.
+    void requestFrame(unsigned char *frame, int stride);
+    bool waitFrame();
+
+    // CLOCK_MONOTONIC time (nanoseconds) when X server was asked to copy last frame.
+    qint64 getFrameTime();
+
+    // In damage mode only damaged rectangles are copied into record frame, so record frame must be persistent.
+    // Rectangles are in record frame coordinate, valid after waitFrame.
+    bool isDamageEnabled();
+    const QVector<xcb_rectangle_t>& getDamagedRects();
+
+    void stop();
+
+protected:
+    void run();
+
+private:
+    xcb_connection_t *conn;
+    ScreenCapture capture;
+
+    QSemaphore requestSemaphore;
+    QSemaphore finishSemaphore;
+    QAtomicInt isStopped;
+
+    unsigned char *targetFrame;
+    int targetStride;
+    bool grabResult;
+    qint64 frameTime;
+    QVector<xcb_rectangle_t> damagedRects;
+    bool needFullCopy;
+
+    int captureWidth;
+    int captureHeight;
+    int targetX;
+    int targetY;
+};
+
+#endif
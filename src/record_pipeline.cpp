@@ -0,0 +1,894 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include "record_pipeline.h"
+#include "screen_capture.h"
+#include "output_capture.h"
+#include "color_convert.h"
+#include "frame_scheduler.h"
+#include "frame_hash.h"
+
+const int RecordPipeline::STAGE_CAPTURE = 0;
+const int RecordPipeline::STAGE_CONVERT = 1;
+const int RecordPipeline::OUTPUT_FORMAT_I420 = 0;
+const int RecordPipeline::OUTPUT_FORMAT_BGRA = 1;
+const int RecordPipeline::QUEUE_DEPTH = 8;
+
+// Encoder keep last frame while take next one.
+const int RecordPipeline::ENCODER_HOLD_FRAMES = 2;
+const int RecordPipeline::WAIT_TIMEOUT = 100;
+
+PipelineStage::PipelineStage(RecordPipeline *p, int s, QObject *parent) : QThread(parent)
+{
+    pipeline = p;
+    stage = s;
+}
+
+void PipelineStage::run()
+{
+    if (stage == RecordPipeline::STAGE_CAPTURE) {
+        pipeline->runCapture();
+    } else {
+        pipeline->runConvert();
+    }
+}
+
+RecordPipeline::RecordPipeline() : convertQueue(QUEUE_DEPTH), encodeQueue(QUEUE_DEPTH)
+{
+    windowManager = NULL;
+    outputFormat = OUTPUT_FORMAT_I420;
+    isScaling = false;
+    isPassThrough = false;
+
+    followWindow = XCB_NONE;
+    followPixmap = XCB_NONE;
+    isFollowRedirected = false;
+    followX = 0;
+    followY = 0;
+    followWidth = 0;
+    followHeight = 0;
+
+    captureStage = new PipelineStage(this, STAGE_CAPTURE);
+    convertStage = new PipelineStage(this, STAGE_CONVERT);
+
+    isPrepared = 0;
+    isStopped = 0;
+    isCaptureFinished = 0;
+    isConvertFinished = 0;
+
+    capturedFrames = 0;
+    missedFrames = 0;
+    captureDroppedFrames = 0;
+    convertDroppedFrames = 0;
+    duplicateFrames = 0;
+    captureDuplicateFrames = 0;
+    lastTimestamp = 0;
+    lastSkippedTimestamp = 0;
+    encodedFrames = 0;
+
+    needResend = 0;
+}
+
+RecordPipeline::~RecordPipeline()
+{
+    stop();
+    wait();
+
+    delete captureStage;
+    delete convertStage;
+    delete windowManager;
+}
+
+bool RecordPipeline::init(int x, int y, int width, int height, bool useDamage, int frameRate, qint64 memoryBudget, bool useHugePage,
+                          int format, int scaledWidth, int scaledHeight)
+{
+    if (!windowManager) {
+        windowManager = new WindowManager();
+    }
+    recordX = x;
+    recordY = y;
+    recordWidth = width;
+    recordHeight = height;
+    recordFrameRate = frameRate;
+    isDamageMode = useDamage;
+    outputFormat = format;
+    outputWidth = scaledWidth;
+    outputHeight = scaledHeight;
+
+    isScaling = outputWidth != recordWidth || outputHeight != recordHeight;
+    if (isScaling && !scaler.init(recordWidth, recordHeight, outputWidth, outputHeight)) {
+        return false;
+    }
+
+    // Frames in flight are bounded by queues: capture and convert stage hold one frame each,
+    // encoder hold ENCODER_HOLD_FRAMES, budget is only upper limit of pool size.
+    int captureFrameNum = 1 + QUEUE_DEPTH + 1;
+    int convertFrameNum = 1 + QUEUE_DEPTH + ENCODER_HOLD_FRAMES;
+
+    // BGRA frames are sent to encoder without copy, capture pool get all budget.
+    int captureFrameSize = recordWidth * 4 * recordHeight;
+    isPassThrough = outputFormat == OUTPUT_FORMAT_BGRA && !isScaling;
+    if (isPassThrough) {
+        return capturePool.init(captureFrameSize, memoryBudget, captureFrameNum + QUEUE_DEPTH + ENCODER_HOLD_FRAMES, useHugePage) && initDamageRows();
+    }
+
+    // Split budget by frame size (I420 1.5 bytes, BGRA 4 bytes per pixel),
+    // so both pools can hold same number of frames.
+    int convertFrameSize = outputFormat == OUTPUT_FORMAT_BGRA ? outputWidth * 4 * outputHeight : outputWidth * outputHeight * 3 / 2;
+    qint64 captureBudget = memoryBudget * captureFrameSize / (captureFrameSize + convertFrameSize);
+
+    if (isScaling && outputFormat == OUTPUT_FORMAT_I420) {
+        scaledFrame.resize(outputWidth * 4 * outputHeight);
+    }
+
+    return capturePool.init(captureFrameSize, captureBudget, captureFrameNum, useHugePage)
+        && convertPool.init(convertFrameSize, memoryBudget - captureBudget, convertFrameNum, useHugePage)
+        && initDamageRows();
+}
+
+bool RecordPipeline::initDamageRows()
+{
+    int capacity = capturePool.getCapacity();
+
+    rowSerials.fill(0, recordHeight);
+    slotSerials.fill(-1, capacity);
+    slotCursorTops.fill(0, capacity);
+    slotCursorBottoms.fill(0, capacity);
+
+    dirtyRows.resize(capacity);
+    for (int i = 0; i < capacity; i++) {
+        dirtyRows[i].fill(1, recordHeight);
+    }
+
+    return true;
+}
+
+void RecordPipeline::setFollowWindow(xcb_window_t window)
+{
+    followWindow = window;
+}
+
+void RecordPipeline::prepare()
+{
+    if (isPrepared.load()) {
+        return;
+    }
+    isPrepared = 1;
+
+    isStopped = 0;
+    isCaptureFinished = 0;
+    isConvertFinished = 0;
+
+    captureStage->start();
+    convertStage->start();
+}
+
+void RecordPipeline::start()
+{
+    prepare();
+    startSemaphore.release();
+}
+
+void RecordPipeline::stop()
+{
+    isStopped = 1;
+}
+
+void RecordPipeline::wait()
+{
+    captureStage->wait();
+    convertStage->wait();
+}
+
+void RecordPipeline::runCapture()
+{
+    FrameScheduler scheduler;
+
+    // Record area on single monitor is captured in this thread,
+    // area span several monitors is captured by one OutputCapture per monitor.
+    ScreenCapture capture;
+    QList<OutputCapture*> outputCaptures;
+    bool hasUncoveredArea = false;
+    bool isReady = initOutputCaptures(outputCaptures, hasUncoveredArea);
+    if (isReady && followWindow != XCB_NONE) {
+        isReady = initFollowCapture(capture);
+    } else if (isReady && outputCaptures.isEmpty()) {
+        isReady = capture.init(windowManager->getConnection(), windowManager->rootWindow, recordX, recordY, recordWidth, recordHeight);
+        if (isReady && isDamageMode && !capture.enableDamage()) {
+            qDebug() << "Enable damage capture failed, grab whole record area every frame.";
+        }
+    }
+
+    if (!isReady) {
+        qDebug() << "Init screen capture failed";
+    } else {
+        // Cursor only move don't damage screen, so frame that only cursor moved need no recapture.
+        cursorTracker.init(windowManager->getConnection(), windowManager->rootWindow);
+
+        // Capture is ready, wait start signal, frame time count from here.
+        while (!startSemaphore.tryAcquire(1, WAIT_TIMEOUT) && !isStopped.load()) {
+        }
+        scheduler.start(recordFrameRate);
+
+        // Frame requested before start may still show countdown, grab it again.
+        if (outputCaptures.isEmpty()) {
+            capture.grabFrame();
+        } else {
+            qint64 frameTime;
+            grabOutputs(outputCaptures, NULL, false, frameTime);
+        }
+
+        int frameSize = capturePool.getFrameSize();
+        bool isDamageCapture = outputCaptures.isEmpty() && followWindow == XCB_NONE && capture.isDamageEnabled();
+
+        // Outputs copy damaged rectangles into one persistent frame, then it is handled same as single capture,
+        // area that no monitor show stay black.
+        if (!outputCaptures.isEmpty() && isDamageMode) {
+            isDamageCapture = true;
+            foreach (auto outputCapture, outputCaptures) {
+                isDamageCapture = isDamageCapture && outputCapture->isDamageEnabled();
+            }
+            if (isDamageCapture) {
+                outputFrame.fill(0, frameSize);
+            }
+        }
+
+        // Damage mode state of last frame pushed to convert stage, serial -1 means nothing pushed yet.
+        qint64 tickSerial = 0;
+        qint64 lastChangeSerial = 0;
+        qint64 lastPushedSerial = -1;
+        int lastCursorX = 0;
+        int lastCursorY = 0;
+        quint32 lastCursorSerial = 0;
+        int lastCursorTop = 0;
+        int lastCursorBottom = 0;
+
+        while (!isStopped.load()) {
+            scheduler.waitNextFrame();
+
+            // Damage events are just hints, only cursor change and followed window configure events need handle.
+            // Window may move many times in one frame, only latest geometry is used.
+            bool isFollowMoved = false;
+            xcb_generic_event_t *event;
+            while ((event = xcb_poll_for_event(windowManager->getConnection())) != NULL) {
+                if (!cursorTracker.handleEvent(event) && isFollowEvent(event)) {
+                    isFollowMoved = true;
+                }
+                free(event);
+            }
+            if (isFollowMoved && !updateFollowArea(capture)) {
+                qDebug() << "Capture followed window failed";
+                break;
+            }
+
+            // Drop frame if convert stage still hold all frames, frame is still grabbed to keep damage in sync.
+            int frameIndex = capturePool.acquire();
+            qint64 frameTime;
+            const unsigned char *frame = NULL;
+            int frameStride = recordWidth * 4;
+            if (outputCaptures.isEmpty()) {
+                frame = capture.grabFrame();
+                frameStride = capture.getStride();
+                if (frame && frameIndex >= 0) {
+                    if (followWindow != XCB_NONE) {
+                        copyFollowFrame(frame, capture, capturePool.getFrame(frameIndex));
+                    } else if (!isDamageCapture) {
+                        memcpy(capturePool.getFrame(frameIndex), frame, frameSize);
+                    }
+                }
+                frameTime = capture.getFrameTime();
+                isReady = frame != NULL;
+            } else if (isDamageCapture) {
+                isReady = grabOutputs(outputCaptures, outputFrame.data(), false, frameTime);
+                frame = outputFrame.constData();
+            } else {
+                isReady = grabOutputs(outputCaptures, frameIndex >= 0 ? capturePool.getFrame(frameIndex) : NULL, hasUncoveredArea, frameTime);
+            }
+            if (!isReady) {
+                if (frameIndex >= 0) {
+                    capturePool.recycle(frameIndex);
+                }
+                break;
+            }
+            cursorTracker.update();
+            capturedFrames++;
+
+            PipelineFrame pipelineFrame;
+            pipelineFrame.timestamp = std::max(frameTime - scheduler.getStartTime(), 0LL);
+            if (followWindow != XCB_NONE) {
+                pipelineFrame.cursorX = (qint64) (cursorTracker.getX() - followArea.x) * followWidth / followArea.width + followX;
+                pipelineFrame.cursorY = (qint64) (cursorTracker.getY() - followArea.y) * followHeight / followArea.height + followY;
+            } else {
+                pipelineFrame.cursorX = cursorTracker.getX() - recordX;
+                pipelineFrame.cursorY = cursorTracker.getY() - recordY;
+            }
+            pipelineFrame.cursorSerial = cursorTracker.getSerial();
+
+            // Rows that cursor drawn on, they change even if screen not damaged.
+            const CursorImage *cursorImage = cursorTracker.getImage(pipelineFrame.cursorSerial);
+            int cursorTop = std::max(pipelineFrame.cursorY, 0);
+            int cursorBottom = std::min(pipelineFrame.cursorY + (cursorImage ? cursorImage->height : 0), recordHeight);
+
+            if (isDamageCapture) {
+                tickSerial++;
+                if (outputCaptures.isEmpty()) {
+                    if (markDamagedRows(capture.getDamagedRects(), tickSerial)) {
+                        lastChangeSerial = tickSerial;
+                    }
+                } else {
+                    foreach (auto outputCapture, outputCaptures) {
+                        if (markDamagedRows(outputCapture->getDamagedRects(), tickSerial)) {
+                            lastChangeSerial = tickSerial;
+                        }
+                    }
+                }
+
+                // Nothing damaged and cursor not moved, frame is same as last one, skip copy and hash.
+                if (lastPushedSerial >= 0 && lastChangeSerial <= lastPushedSerial &&
+                    pipelineFrame.cursorX == lastCursorX && pipelineFrame.cursorY == lastCursorY &&
+                    pipelineFrame.cursorSerial == lastCursorSerial &&
+                    !needResend.fetchAndStoreOrdered(0)) {
+                    if (frameIndex >= 0) {
+                        capturePool.recycle(frameIndex);
+                    }
+                    captureDuplicateFrames++;
+                    lastSkippedTimestamp = pipelineFrame.timestamp;
+                    continue;
+                }
+            }
+
+            if (frameIndex < 0) {
+                captureDroppedFrames++;
+                continue;
+            }
+
+            uchar *dirty = dirtyRows[frameIndex].data();
+            if (isDamageCapture) {
+                copyDamagedRows(frame, frameStride, frameIndex);
+                slotSerials[frameIndex] = tickSerial;
+                slotCursorTops[frameIndex] = cursorTop;
+                slotCursorBottoms[frameIndex] = cursorBottom;
+
+                for (int row = 0; row < recordHeight; row++) {
+                    dirty[row] = lastPushedSerial < 0 || rowSerials[row] > lastPushedSerial ||
+                        (row >= cursorTop && row < cursorBottom) || (row >= lastCursorTop && row < lastCursorBottom);
+                }
+            } else {
+                memset(dirty, 1, recordHeight);
+            }
+
+            pipelineFrame.index = frameIndex;
+            if (convertQueue.push(pipelineFrame)) {
+                convertSemaphore.release();
+
+                lastPushedSerial = tickSerial;
+                lastCursorX = pipelineFrame.cursorX;
+                lastCursorY = pipelineFrame.cursorY;
+                lastCursorSerial = pipelineFrame.cursorSerial;
+                lastCursorTop = cursorTop;
+                lastCursorBottom = cursorBottom;
+            } else {
+                capturePool.recycle(frameIndex);
+                captureDroppedFrames++;
+            }
+        }
+    }
+
+    capture.release();
+    qDeleteAll(outputCaptures);
+    releaseFollowCapture();
+
+    missedFrames = scheduler.getMissedFrames();
+
+    isCaptureFinished = 1;
+    convertSemaphore.release();
+}
+
+bool RecordPipeline::initOutputCaptures(QList<OutputCapture*> &outputCaptures, bool &hasUncoveredArea)
+{
+    // Followed window can move across monitors, capture it from root window in capture thread.
+    if (followWindow != XCB_NONE) {
+        hasUncoveredArea = false;
+        return true;
+    }
+
+    QList<WindowRect> monitorRects = windowManager->getMonitorRects();
+
+    QList<WindowRect> regions;
+    qint64 coveredArea = 0;
+    for (int i = 0; i < monitorRects.length(); i++) {
+        WindowRect region;
+        region.x = std::max(recordX, monitorRects[i].x);
+        region.y = std::max(recordY, monitorRects[i].y);
+        region.width = std::min(recordX + recordWidth, monitorRects[i].x + monitorRects[i].width) - region.x;
+        region.height = std::min(recordY + recordHeight, monitorRects[i].y + monitorRects[i].height) - region.y;
+        if (region.width > 0 && region.height > 0) {
+            regions.append(region);
+            coveredArea += region.width * region.height;
+        }
+    }
+
+    // Whole record area on one monitor, no need split.
+    hasUncoveredArea = coveredArea < (qint64) recordWidth * recordHeight;
+    if (regions.length() == 1 && !hasUncoveredArea) {
+        return true;
+    }
+    if (regions.isEmpty()) {
+        qDebug() << "Record area is not on any monitor";
+        return false;
+    }
+
+    for (int i = 0; i < regions.length(); i++) {
+        OutputCapture *outputCapture = new OutputCapture();
+        outputCaptures.append(outputCapture);
+        if (!outputCapture->init(regions[i].x, regions[i].y, regions[i].width, regions[i].height,
+                                 regions[i].x - recordX, regions[i].y - recordY, isDamageMode)) {
+            return false;
+        }
+    }
+
+    qDebug() << QString("Record area span %1 monitors, capture them in parallel").arg(regions.length());
+
+    return true;
+}
+
+bool RecordPipeline::grabOutputs(QList<OutputCapture*> &outputCaptures, unsigned char *frame, bool clearFrame, qint64 &frameTime)
+{
+    // Area between monitors of different size show nothing, fill it with black.
+    if (frame && clearFrame) {
+        memset(frame, 0, capturePool.getFrameSize());
+    }
+
+    for (int i = 0; i < outputCaptures.length(); i++) {
+        outputCaptures[i]->requestFrame(frame, recordWidth * 4);
+    }
+
+    // Use earliest request time, outputs are requested at almost same time.
+    bool result = true;
+    frameTime = 0;
+    for (int i = 0; i < outputCaptures.length(); i++) {
+        if (!outputCaptures[i]->waitFrame()) {
+            result = false;
+        } else if (frameTime == 0 || outputCaptures[i]->getFrameTime() < frameTime) {
+            frameTime = outputCaptures[i]->getFrameTime();
+        }
+    }
+
+    return result;
+}
+
+bool RecordPipeline::isFollowEvent(xcb_generic_event_t *event)
+{
+    if ((event->response_type & ~0x80) != XCB_CONFIGURE_NOTIFY) {
+        return false;
+    }
+
+    xcb_configure_notify_event_t *configureEvent = (xcb_configure_notify_event_t *) event;
+    return followWindows.contains(configureEvent->window);
+}
+
+bool RecordPipeline::initFollowCapture(ScreenCapture &capture)
+{
+    followWindows = windowManager->selectConfigureEvents(followWindow);
+    followRect = windowManager->getWindowRect(followWindow);
+
+    // Capture window own pixmap when Composite is available, window covered by other windows is still recorded,
+    // and X server only copy window instead of root area. Pixmap belong to top level (frame) window.
+    isFollowRedirected = !followWindows.isEmpty() && windowManager->redirectWindow(followWindows.last());
+    if (!isFollowRedirected) {
+        qDebug() << "Composite extension is not available, capture followed window from root window.";
+    }
+
+    return captureFollowWindow(capture);
+}
+
+bool RecordPipeline::captureFollowWindow(ScreenCapture &capture)
+{
+    capture.release();
+    if (followPixmap != XCB_NONE) {
+        xcb_free_pixmap(windowManager->getConnection(), followPixmap);
+        followPixmap = XCB_NONE;
+    }
+
+    if (isFollowRedirected) {
+        WindowRect pixmapRect;
+        followPixmap = windowManager->nameWindowPixmap(followWindows.last(), pixmapRect);
+        if (followPixmap != XCB_NONE) {
+            // Window area in pixmap, pixmap is not limited by screen.
+            followArea.x = std::max(followRect.x, pixmapRect.x);
+            followArea.y = std::max(followRect.y, pixmapRect.y);
+            followArea.width = (std::min(followRect.x + followRect.width, pixmapRect.x + pixmapRect.width) - followArea.x) & ~1;
+            followArea.height = (std::min(followRect.y + followRect.height, pixmapRect.y + pixmapRect.height) - followArea.y) & ~1;
+
+            // Damage only track root window, grab whole window every frame, duplicate frames are dropped by convert stage.
+            if (followArea.width >= 2 && followArea.height >= 2 &&
+                capture.init(windowManager->getConnection(), followPixmap,
+                             followArea.x - pixmapRect.x, followArea.y - pixmapRect.y, followArea.width, followArea.height)) {
+                updateFollowLayout(followArea.width, followArea.height);
+                return true;
+            }
+
+            xcb_free_pixmap(windowManager->getConnection(), followPixmap);
+            followPixmap = XCB_NONE;
+        }
+        qDebug() << "Capture followed window pixmap failed, capture it from root window.";
+    }
+
+    // Only part of window inside screen can be captured from root window, keep even size as record area.
+    followArea = windowManager->adjustRectInScreenArea(followRect);
+    followArea.width &= ~1;
+    followArea.height &= ~1;
+    if (followArea.width < 2 || followArea.height < 2) {
+        return false;
+    }
+
+    if (!capture.init(windowManager->getConnection(), windowManager->rootWindow, followArea.x, followArea.y, followArea.width, followArea.height)) {
+        return false;
+    }
+    if (isDamageMode && !capture.enableDamage()) {
+        qDebug() << "Enable damage capture failed, grab whole record area every frame.";
+    }
+
+    updateFollowLayout(followArea.width, followArea.height);
+
+    return true;
+}
+
+bool RecordPipeline::updateFollowArea(ScreenCapture &capture)
+{
+    WindowRect rect = windowManager->getWindowRect(followWindow);
+
+    // Window is destroyed, keep last frame.
+    if (rect.width < 2 || rect.height < 2) {
+        return true;
+    }
+
+    bool isResized = rect.width != followRect.width || rect.height != followRect.height;
+    int moveX = rect.x - followRect.x;
+    int moveY = rect.y - followRect.y;
+    followRect = rect;
+
+    // Window pixmap don't change when window move, new pixmap is allocated after resize.
+    if (followPixmap != XCB_NONE) {
+        if (isResized) {
+            return captureFollowWindow(capture);
+        }
+
+        followArea.x += moveX;
+        followArea.y += moveY;
+        return true;
+    }
+
+    WindowRect area = windowManager->adjustRectInScreenArea(rect);
+    area.width &= ~1;
+    area.height &= ~1;
+
+    // Window moved out of screen, keep last area.
+    if (area.width < 2 || area.height < 2) {
+        return true;
+    }
+
+    if (area.width == followArea.width && area.height == followArea.height) {
+        if (area.x != followArea.x || area.y != followArea.y) {
+            capture.moveTo(area.x, area.y);
+            followArea = area;
+        }
+        return true;
+    }
+
+    // Size changed, SHM segments need reallocate.
+    return captureFollowWindow(capture);
+}
+
+void RecordPipeline::releaseFollowCapture()
+{
+    if (followPixmap != XCB_NONE) {
+        xcb_free_pixmap(windowManager->getConnection(), followPixmap);
+        followPixmap = XCB_NONE;
+    }
+
+    if (isFollowRedirected) {
+        windowManager->unredirectWindow(followWindows.last());
+        isFollowRedirected = false;
+    }
+}
+
+void RecordPipeline::updateFollowLayout(int width, int height)
+{
+    // Window smaller than record area is centered, bigger one is downscaled and keep aspect ratio.
+    if (width <= recordWidth && height <= recordHeight) {
+        followWidth = width;
+        followHeight = height;
+    } else {
+        followWidth = recordWidth;
+        followHeight = std::max((int) ((qint64) height * recordWidth / width), 2);
+        if (followHeight > recordHeight) {
+            followWidth = std::max((int) ((qint64) width * recordHeight / height), 2);
+            followHeight = recordHeight;
+        }
+
+        followScaler.init(width, height, followWidth, followHeight);
+    }
+
+    followX = (recordWidth - followWidth) / 2;
+    followY = (recordHeight - followHeight) / 2;
+}
+
+void RecordPipeline::copyFollowFrame(const unsigned char *frame, ScreenCapture &capture, unsigned char *output)
+{
+    // Padding area is black.
+    if (followWidth != recordWidth || followHeight != recordHeight) {
+        memset(output, 0, capturePool.getFrameSize());
+    }
+
+    unsigned char *target = output + followY * recordWidth * 4 + followX * 4;
+    if (followWidth != capture.getWidth() || followHeight != capture.getHeight()) {
+        followScaler.scale(frame, capture.getStride(), target, recordWidth * 4);
+    } else {
+        for (int row = 0; row < followHeight; row++) {
+            memcpy(target + row * recordWidth * 4, frame + row * capture.getStride(), followWidth * 4);
+        }
+    }
+}
+
+bool RecordPipeline::markDamagedRows(const QVector<xcb_rectangle_t> &rects, qint64 serial)
+{
+    foreach (auto rect, rects) {
+        for (int row = rect.y; row < rect.y + rect.height; row++) {
+            rowSerials[row] = serial;
+        }
+    }
+
+    return !rects.isEmpty();
+}
+
+void RecordPipeline::copyDamagedRows(const unsigned char *frame, int stride, int frameIndex)
+{
+    // Slot keep frame of tick slotSerial with cursor drawn on it, LIFO pool usually give back the slot encoder just released,
+    // so only few rows need copy.
+    unsigned char *output = capturePool.getFrame(frameIndex);
+    qint64 slotSerial = slotSerials[frameIndex];
+    int cursorTop = slotCursorTops[frameIndex];
+    int cursorBottom = slotCursorBottoms[frameIndex];
+    int rowSize = recordWidth * 4;
+
+    for (int row = 0; row < recordHeight; row++) {
+        if (rowSerials[row] > slotSerial || (row >= cursorTop && row < cursorBottom)) {
+            memcpy(output + row * rowSize, frame + row * stride, rowSize);
+        }
+    }
+}
+
+void RecordPipeline::runConvert()
+{
+    int ySize = outputWidth * outputHeight;
+    int uvSize = ySize / 4;
+
+    // Row hashes of last frame from capture stage and last frame that send to encoder,
+    // capture mark rows that differ from its last frame, other rows keep hash.
+    QVector<quint64> rowHashes(recordHeight);
+    QVector<quint64> lastRowHashes(recordHeight);
+    bool hasLastFrame = false;
+
+    while (true) {
+        PipelineFrame inputFrame;
+        if (!convertQueue.pop(inputFrame)) {
+            // Check queue again after finish flag, capture may push last frame before set flag.
+            if (isCaptureFinished.loadAcquire() && !convertQueue.pop(inputFrame)) {
+                break;
+            }
+            convertSemaphore.tryAcquire(1, WAIT_TIMEOUT);
+            continue;
+        }
+
+        lastTimestamp = inputFrame.timestamp;
+
+        // Draw cursor before compare, frame that only cursor moved is not duplicate.
+        unsigned char *input = capturePool.getFrame(inputFrame.index);
+        CursorTracker::blendCursor(input, recordWidth * 4, recordWidth, recordHeight,
+                                   inputFrame.cursorX, inputFrame.cursorY, cursorTracker.getImage(inputFrame.cursorSerial));
+
+        // Drop frame same as last one, Matroska block last until next block,
+        // so last frame will display longer and encoder don't need handle it.
+        const uchar *dirty = dirtyRows[inputFrame.index].constData();
+        for (int row = 0; row < recordHeight;) {
+            if (!dirty[row]) {
+                row++;
+                continue;
+            }
+
+            int rowEnd = row + 1;
+            while (rowEnd < recordHeight && dirty[rowEnd]) {
+                rowEnd++;
+            }
+            FrameHash::hashRows(input + row * recordWidth * 4, recordWidth * 4, recordWidth * 4, rowEnd - row, rowHashes.data() + row);
+            row = rowEnd;
+        }
+        if (hasLastFrame && rowHashes == lastRowHashes) {
+            capturePool.recycle(inputFrame.index);
+            duplicateFrames++;
+            continue;
+        }
+
+        int outputIndex = inputFrame.index;
+        if (!isPassThrough) {
+            outputIndex = convertPool.acquire();
+            if (outputIndex < 0) {
+                capturePool.recycle(inputFrame.index);
+                convertDroppedFrames++;
+                needResend = 1;
+                continue;
+            }
+
+            unsigned char *output = convertPool.getFrame(outputIndex);
+            if (outputFormat == OUTPUT_FORMAT_BGRA) {
+                scaler.scale(input, recordWidth * 4, output, outputWidth * 4);
+            } else {
+                const unsigned char *source = input;
+                int sourceStride = recordWidth * 4;
+                if (isScaling) {
+                    scaler.scale(input, recordWidth * 4, scaledFrame.data(), outputWidth * 4);
+                    source = scaledFrame.constData();
+                    sourceStride = outputWidth * 4;
+                }
+
+                ColorConvert::bgraToI420(source, sourceStride, outputWidth, outputHeight,
+                                         output, outputWidth,
+                                         output + ySize, outputWidth / 2,
+                                         output + ySize + uvSize, outputWidth / 2);
+            }
+            capturePool.recycle(inputFrame.index);
+        }
+
+        PipelineFrame outputFrame;
+        outputFrame.index = outputIndex;
+        outputFrame.timestamp = inputFrame.timestamp;
+        if (encodeQueue.push(outputFrame)) {
+            encodeSemaphore.release();
+
+            // Only compare with frame that encoder really got.
+            lastRowHashes = rowHashes;
+            hasLastFrame = true;
+        } else {
+            recycleFrame(outputIndex);
+            convertDroppedFrames++;
+            needResend = 1;
+        }
+    }
+
+    isConvertFinished = 1;
+    encodeSemaphore.release();
+}
+
+bool RecordPipeline::popFrame(PipelineFrame &frame, int timeout, bool *isTimeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (isTimeout) {
+        *isTimeout = false;
+    }
+
+    while (true) {
+        if (encodeQueue.pop(frame)) {
+            return true;
+        }
+
+        if (isConvertFinished.loadAcquire()) {
+            return encodeQueue.pop(frame);
+        }
+
+        if (timeout < 0) {
+            encodeSemaphore.tryAcquire(1, WAIT_TIMEOUT);
+        } else {
+            qint64 remainTime = timeout - timer.elapsed();
+            if (remainTime <= 0) {
+                if (isTimeout) {
+                    *isTimeout = true;
+                }
+                return false;
+            }
+            encodeSemaphore.tryAcquire(1, std::min((qint64) WAIT_TIMEOUT, remainTime));
+        }
+    }
+}
+
+unsigned char* RecordPipeline::getFrame(int index)
+{
+    return isPassThrough ? capturePool.getFrame(index) : convertPool.getFrame(index);
+}
+
+int RecordPipeline::getFrameSize()
+{
+    return isPassThrough ? capturePool.getFrameSize() : convertPool.getFrameSize();
+}
+
+int RecordPipeline::getWidth()
+{
+    return outputWidth;
+}
+
+int RecordPipeline::getHeight()
+{
+    return outputHeight;
+}
+
+void RecordPipeline::recycleFrame(int index)
+{
+    if (isPassThrough) {
+        capturePool.recycle(index);
+    } else {
+        convertPool.recycle(index);
+    }
+}
+
+void RecordPipeline::finishEncode(qint64 frameNum)
+{
+    encodedFrames = frameNum;
+}
+
+qint64 RecordPipeline::getLastTimestamp()
+{
+    return std::max(lastTimestamp, lastSkippedTimestamp);
+}
+
+void RecordPipeline::printStatistics()
+{
+    qDebug() << QString("Captured %1 frames, missed %2 frame deadlines, encoded %3 frames, dropped %4 frames in capture stage, %5 frames in convert stage")
+        .arg(capturedFrames).arg(missedFrames).arg(encodedFrames).arg(captureDroppedFrames).arg(convertDroppedFrames);
+    qDebug() << QString("Skipped %1 undamaged frames in capture stage, %2 duplicate frames (%3 row hash)")
+        .arg(captureDuplicateFrames).arg(duplicateFrames).arg(FrameHash::getImplementationName());
+    qDebug() << QString("Color convert: %1").arg(ColorConvert::getImplementationName(ColorConvert::getImplementation()));
+    if (isScaling) {
+        qDebug() << QString("Scaled %1x%2 to %3x%4 in %5 passes with %6 threads")
+            .arg(recordWidth).arg(recordHeight).arg(outputWidth).arg(outputHeight).arg(scaler.getPassNum()).arg(scaler.getThreadNum());
+    }
+    qDebug() << QString("Frame pool peak usage: capture %1/%2, convert %3/%4")
+        .arg(capturePool.getPeakUsedNum()).arg(capturePool.getCapacity())
+        .arg(convertPool.getPeakUsedNum()).arg(convertPool.getCapacity());
+}
+
+qint64 RecordPipeline::getCapturedFrames()
+{
+    return capturedFrames;
+}
+
+qint64 RecordPipeline::getMissedFrames()
+{
+    return missedFrames;
+}
+
+qint64 RecordPipeline::getDroppedFrames()
+{
+    return captureDroppedFrames + convertDroppedFrames;
+}
+
+qint64 RecordPipeline::getDuplicateFrames()
+{
+    return duplicateFrames + captureDuplicateFrames;
+}
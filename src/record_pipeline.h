@@ -0,0 +1,232 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDPIPELINE_H
+#define RECORDPIPELINE_H
+
+#include <QThread>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QList>
+#include "window_manager.h"
+#include "frame_pool.h"
+#include "spsc_queue.h"
+#include "cursor_tracker.h"
+#include "frame_scaler.h"
+
+class RecordPipeline;
+class OutputCapture;
+class ScreenCapture;
+
+struct PipelineFrame {
+    int index;
+
+    // Capture time in nanoseconds since record start.
+    qint64 timestamp;
+
+    // Cursor image position in record area, cursor is drawn in convert stage.
+    int cursorX;
+    int cursorY;
+    quint32 cursorSerial;
+};
+
+class PipelineStage : public QThread
+{
+    Q_OBJECT
+
+public:
+    PipelineStage(RecordPipeline *pipeline, int stage, QObject *parent = 0);
+
+protected:
+    void run();
+
+private:
+    RecordPipeline *pipeline;
+    int stage;
+};
+
+// Record pipeline: capture thread -> convert thread -> encoder thread.
+// Video encoder get I420 frames, GIF encoder get BGRA frames that pass through convert stage,
+// duplicate frames are skipped in both cases.
+// Frames are downscaled in convert stage when output size is smaller than record area.
+// Stages are linked by bounded lock-free queues, when next stage can't keep up,
+// frame is dropped and counted instead of blocking capture.
+class RecordPipeline
+{
+public:
+    static const int STAGE_CAPTURE;
+    static const int STAGE_CONVERT;
+    static const int OUTPUT_FORMAT_I420;
+    static const int OUTPUT_FORMAT_BGRA;
+    static const int QUEUE_DEPTH;
+    static const int ENCODER_HOLD_FRAMES;
+    static const int WAIT_TIMEOUT;
+
+    RecordPipeline();
+    ~RecordPipeline();
+
+    bool init(int x, int y, int width, int height, bool useDamage, int frameRate, qint64 memoryBudget, bool useHugePage,
+              int format, int scaledWidth, int scaledHeight);
+
+    // Move capture area with window instead of record fixed area, output size don't change,
+    // window is padded with black or downscaled to fit in record size. Must set before prepare().
+    void setFollowWindow(xcb_window_t window);
+
+    // Start stage threads and connect capture, but don't grab until start() is called.
+    void prepare();
+    void start();
+    void stop();
+    void wait();
+
+    // Encoder side API, popFrame block until frame arrived or pipeline finished.
+    // With non-negative timeout (ms), it also return false when no frame arrived in time, and set isTimeout.
+    bool popFrame(PipelineFrame &frame, int timeout = -1, bool *isTimeout = NULL);
+    unsigned char* getFrame(int index);
+    int getFrameSize();
+    int getWidth();
+    int getHeight();
+    void recycleFrame(int index);
+    void finishEncode(qint64 frameNum);
+
+    // Capture time of last frame, include duplicate frames that not send to encoder.
+    qint64 getLastTimestamp();
+
+    void runCapture();
+    void runConvert();
+    void printStatistics();
+
+    // Statistics, only valid after all stages finished.
+    qint64 getCapturedFrames();
+    qint64 getMissedFrames();
+    qint64 getDroppedFrames();
+    qint64 getDuplicateFrames();
+
+private:
+    bool initDamageRows();
+
+    // Create one capture per monitor when record area is not inside single monitor,
+    // list is left empty otherwise.
+    bool initOutputCaptures(QList<OutputCapture*> &outputCaptures, bool &hasUncoveredArea);
+    bool grabOutputs(QList<OutputCapture*> &outputCaptures, unsigned char *frame, bool clearFrame, qint64 &frameTime);
+
+    bool isFollowEvent(xcb_generic_event_t *event);
+    bool initFollowCapture(ScreenCapture &capture);
+    bool captureFollowWindow(ScreenCapture &capture);
+    bool updateFollowArea(ScreenCapture &capture);
+    void releaseFollowCapture();
+    void updateFollowLayout(int width, int height);
+    void copyFollowFrame(const unsigned char *frame, ScreenCapture &capture, unsigned char *output);
+
+    // Set serial of rows that damaged rectangles cover, return false if no rectangle.
+    bool markDamagedRows(const QVector<xcb_rectangle_t> &rects, qint64 serial);
+
+    // Copy rows of persistent damage frame that changed since frame in slot was copied.
+    void copyDamagedRows(const unsigned char *frame, int stride, int frameIndex);
+
+    // Capture thread own WindowManager (X connection and atom cache, atoms are interned when it's created in init),
+    // WindowManager of GUI thread is not thread safe.
+    WindowManager *windowManager;
+
+    PipelineStage *captureStage;
+    PipelineStage *convertStage;
+
+    CursorTracker cursorTracker;
+    FrameScaler scaler;
+
+    // Scaled BGRA frame before convert to I420.
+    QVector<unsigned char> scaledFrame;
+
+    // Followed window and its frame windows, and where window is placed in record frame.
+    xcb_window_t followWindow;
+    QList<xcb_window_t> followWindows;
+    FrameScaler followScaler;
+
+    // Latest window rect and captured area of it in root window,
+    // area is read from pixmap of top level window if it's redirected.
+    WindowRect followRect;
+    WindowRect followArea;
+    bool isFollowRedirected;
+    xcb_pixmap_t followPixmap;
+    int followX;
+    int followY;
+    int followWidth;
+    int followHeight;
+
+    FramePool capturePool;
+    FramePool convertPool;
+
+    // Persistent frame that outputs copy damaged rectangles into, when record area span several monitors.
+    QVector<unsigned char> outputFrame;
+
+    // Damage mode bookkeeping, only used by capture stage.
+    // Serial is capture tick that persistent frame row last changed, or that frame in slot was copied.
+    QVector<qint64> rowSerials;
+    QVector<qint64> slotSerials;
+    QVector<int> slotCursorTops;
+    QVector<int> slotCursorBottoms;
+
+    // Rows of frame in capture slot that differ from last frame pushed to convert stage,
+    // written by capture before push, convert only re-hash these rows.
+    QVector<QVector<uchar> > dirtyRows;
+
+    // Convert stage dropped a frame, capture must send frame even if screen not changed.
+    QAtomicInt needResend;
+
+    SpscQueue<PipelineFrame> convertQueue;
+    SpscQueue<PipelineFrame> encodeQueue;
+    QSemaphore convertSemaphore;
+    QSemaphore encodeSemaphore;
+    QSemaphore startSemaphore;
+
+    QAtomicInt isPrepared;
+    QAtomicInt isStopped;
+    QAtomicInt isCaptureFinished;
+    QAtomicInt isConvertFinished;
+
+    int recordX;
+    int recordY;
+    int recordWidth;
+    int recordHeight;
+    int recordFrameRate;
+    bool isDamageMode;
+    int outputFormat;
+    int outputWidth;
+    int outputHeight;
+    bool isScaling;
+
+    // BGRA frames without scaling are sent to encoder from capture pool.
+    bool isPassThrough;
+
+    // Every counter only write by one stage, read after all stages finished.
+    qint64 capturedFrames;
+    qint64 missedFrames;
+    qint64 captureDroppedFrames;
+    qint64 convertDroppedFrames;
+    qint64 duplicateFrames;
+    qint64 captureDuplicateFrames;
+    qint64 lastTimestamp;
+    qint64 lastSkippedTimestamp;
+    qint64 encodedFrames;
+};
+
+#endif
@@ -27,16 +27,47 @@
 #include <QtDBus>
 #include <QDir>
 #include <QStandardPaths>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <stdio.h>
 #include "record_process.h"
+#include "matroska_writer.h"
+#include "gif_writer.h"
+#include "gif_encoder.h"
 #include "utils.h"
 #include "settings.h"
 
 const int RecordProcess::RECORD_TYPE_VIDEO = 0;
 const int RecordProcess::RECORD_TYPE_GIF = 1;
-const int RecordProcess::RECORD_GIF_SLEEP_TIME = 1000;
+const int RecordProcess::RECORD_FRAME_RATE = 25;
+const int RecordProcess::RECORD_GIF_FRAME_RATE = 10;
+const int RecordProcess::CAPTURE_MODE_FULL = 0;
+const int RecordProcess::CAPTURE_MODE_DAMAGE = 1;
+const int RecordProcess::FRAME_POOL_BUDGET = 256;
+const int RecordProcess::SAVE_BUFFER_SIZE = 4 * 1024 * 1024;
+const int RecordProcess::ENCODER_STOP_TIMEOUT = 10000;
+const int RecordProcess::ENCODER_KILL_TIMEOUT = 2000;
+const int RecordProcess::ENCODER_DRAIN_INTERVAL = 100;
+const int RecordProcess::REPLAY_DURATION = 30;
+const int RecordProcess::REPLAY_MEMORY_LIMIT = 64;
+
+// Encoder flush has no progress, it is reported as encoding, then moving file take rest progress.
+const int RecordProcess::FINALIZE_PROGRESS_ENCODING = -1;
+const int RecordProcess::FINALIZE_PROGRESS_ENCODED = 50;
 
 RecordProcess::RecordProcess(QObject *parent) : QThread(parent)
 {
+    windowManager = NULL;
+    isPrepared = false;
+    isStopping = false;
+    isCanceled = 0;
+    notificationId = 0;
+    isQuitPending = false;
+
+    // Record thread report finalize state, notification and quit happen in GUI thread.
+    connect(this, SIGNAL(finalizeProgress(int)), this, SLOT(updateSaveNotification(int)), Qt::QueuedConnection);
+    connect(this, SIGNAL(finalizeFinished(QString)), this, SLOT(finishRecord(QString)), Qt::QueuedConnection);
+
     saveTempDir = QStandardPaths::standardLocations(QStandardPaths::TempLocation).first();
     defaultSaveDir = QStandardPaths::standardLocations(QStandardPaths::DesktopLocation).first();
 
@@ -61,50 +92,258 @@ RecordProcess::RecordProcess(QObject *parent) : QThread(parent)
     }
 
     settings->setOption("save_directory", saveDir);
+
+    // Only copy changed screen parts by default, set 'capture_mode' to 'full' to grab whole area every frame.
+    QVariant captureModeOption = settings->getOption("capture_mode");
+    if (!captureModeOption.isNull() && captureModeOption.toString() == "full") {
+        captureMode = CAPTURE_MODE_FULL;
+    } else {
+        captureMode = CAPTURE_MODE_DAMAGE;
+    }
+
+    QVariant frameRateOption = settings->getOption("frame_rate");
+    recordFrameRate = frameRateOption.isNull() ? RECORD_FRAME_RATE : qBound(1, frameRateOption.toInt(), 120);
+
+    // Memory budget (MB) is upper limit of preallocated frames, huge pages is optional.
+    QVariant budgetOption = settings->getOption("frame_pool_budget");
+    framePoolBudget = (budgetOption.isNull() ? FRAME_POOL_BUDGET : budgetOption.toInt()) * 1024LL * 1024LL;
+    framePoolHugePage = settings->getOption("frame_pool_hugepage").toBool();
+
+    followWindowMode = settings->getOption("follow_window").toBool();
+    recordWindow = XCB_NONE;
+
+    // Downscale HiDPI record area before encode, 'output_scale' is percent of record area,
+    // 'output_fit' is preset like 1080p that output must fit in (1920x1080 box).
+    QVariant scaleOption = settings->getOption("output_scale");
+    outputScale = scaleOption.isNull() ? 100 : scaleOption.toInt();
+    QString fitOption = settings->getOption("output_fit").toString();
+    outputMaxHeight = fitOption.endsWith("p") ? fitOption.left(fitOption.length() - 1).toInt() : 0;
+    outputMaxWidth = outputMaxHeight * 16 / 9;
+
+    // Time (ms) ffmpeg can take to flush after input finished, it will be terminated after that.
+    QVariant stopTimeoutOption = settings->getOption("encoder_stop_timeout");
+    encoderStopTimeout = stopTimeoutOption.isNull() ? ENCODER_STOP_TIMEOUT : stopTimeoutOption.toInt();
+    encoderFrameNum = 0;
+
+    // Instant replay mode keep last 'replay_duration' seconds in memory (at most 'replay_memory' MB),
+    // launch recorder again to save them.
+    replayMode = settings->getOption("instant_replay").toBool();
+    QVariant replayDurationOption = settings->getOption("replay_duration");
+    QVariant replayMemoryOption = settings->getOption("replay_memory");
+    replayBuffer.init((replayDurationOption.isNull() ? REPLAY_DURATION : replayDurationOption.toInt()) * 1000LL,
+                      (replayMemoryOption.isNull() ? REPLAY_MEMORY_LIMIT : replayMemoryOption.toInt()) * 1024LL * 1024LL);
 }
 
-void RecordProcess::setRecordInfo(int rx, int ry, int rw, int rh, QString name, int sw, int sh)
+bool RecordProcess::setRecordInfo(int rx, int ry, int rw, int rh, QString name)
 {
-    recordX = rx;
-    recordY = ry;
-    recordWidth = rx + rw <= sw ? rw : sw - rx;
-    recordHeight = ry + rh <= sh ? rh : sh - ry;
+    // Clamp to bounding box of all monitors, part that no monitor show is captured as black.
+    QList<WindowRect> monitorRects = windowManager->getMonitorRects();
+    if (monitorRects.isEmpty()) {
+        monitorRects.append(windowManager->getRootWindowRect());
+    }
+    int left = monitorRects[0].x;
+    int top = monitorRects[0].y;
+    int right = monitorRects[0].x + monitorRects[0].width;
+    int bottom = monitorRects[0].y + monitorRects[0].height;
+    for (int i = 1; i < monitorRects.length(); i++) {
+        left = std::min(left, monitorRects[i].x);
+        top = std::min(top, monitorRects[i].y);
+        right = std::max(right, monitorRects[i].x + monitorRects[i].width);
+        bottom = std::max(bottom, monitorRects[i].y + monitorRects[i].height);
+    }
+
+    recordX = std::max(rx, left);
+    recordY = std::max(ry, top);
+    recordWidth = std::min(rx + rw, right) - recordX;
+    recordHeight = std::min(ry + rh, bottom) - recordY;
+
+    // YUV 4:2:0 need even size.
+    recordWidth &= ~1;
+    recordHeight &= ~1;
     saveAreaName = name;
+
+    // Area is outside of all monitors.
+    if (recordWidth <= 0 || recordHeight <= 0) {
+        qDebug() << QString("Record area %1x%2+%3+%4 is not on any monitor").arg(rw).arg(rh).arg(rx).arg(ry);
+        return false;
+    }
+
+    return true;
 }
 
 void RecordProcess::setRecordType(int type)
 {
-    recordType = type;
+    // Replay is saved by remux encoded stream, only video can do that.
+    recordType = replayMode ? RECORD_TYPE_VIDEO : type;
+}
+
+void RecordProcess::setWindowManager(WindowManager *wm)
+{
+    windowManager = wm;
+}
+
+void RecordProcess::setCaptureMode(int mode)
+{
+    captureMode = mode;
+}
+
+void RecordProcess::setRecordWindow(xcb_window_t window)
+{
+    recordWindow = window;
 }
 
 void RecordProcess::run()
 {
     // Start record.
-    recordType == RECORD_TYPE_GIF ? recordGIF() : recordVideo();
-
-    // Got output or error.
-    process->waitForFinished(-1);
-    if (process->exitCode() !=0) {
-        qDebug() << "Error";
-        foreach (auto line, (process->readAllStandardError().split('\n'))) {
-            qDebug() << line;
+    if (recordType == RECORD_TYPE_GIF) {
+        encodeGIF();
+    } else {
+        recordVideo();
+        encodeVideo();
+
+        // Flush and mux may take encoder_stop_timeout, let user know saving is not stuck.
+        reportFinalizeProgress(FINALIZE_PROGRESS_ENCODING);
+        stopEncoder();
+        reportFinalizeProgress(FINALIZE_PROGRESS_ENCODED);
+
+        // Got output or error, stdout is progress report and already consumed.
+        if (process->exitCode() !=0) {
+            qDebug() << "Error";
+            foreach (auto line, (process->readAllStandardError().split('\n'))) {
+                qDebug() << line;
+            }
+        } else{
+            qDebug() << "OK" << process->readAllStandardError();
         }
-    } else{
-        qDebug() << "OK" << process->readAllStandardOutput() << process->readAllStandardError();
+    }
+
+    // Move file in record thread too, it may copy whole file if save directory is on other filesystem.
+    // Replay mode has no file, replays are saved when asked.
+    if (!isCanceled.load()) {
+        emit finalizeFinished(replayMode ? QString() : moveSaveFile());
     }
 }
 
-void RecordProcess::recordGIF()
+QString RecordProcess::moveSaveFile()
 {
-    initProcess();
+    QString newSavePath = QDir(saveDir).filePath(saveBaseName);
 
-    QStringList arguments;
-    arguments << QString("--duration=%1").arg(864000);
-    arguments << QString("--x=%1").arg(recordX) << QString("--y=%1").arg(recordY);
-    arguments << QString("--width=%1").arg(recordWidth) << QString("--height=%1").arg(recordHeight);
-    arguments << savePath;
+    // Rename is instant on same filesystem, QFile::rename would silently copy without progress otherwise.
+    if (::rename(QFile::encodeName(savePath).constData(), QFile::encodeName(newSavePath).constData()) == 0) {
+        return newSavePath;
+    }
+
+    QFile source(savePath);
+    QFile target(newSavePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        qDebug() << QString("Open %1 failed: %2").arg(savePath).arg(source.errorString());
+        return savePath;
+    }
+    if (!target.open(QIODevice::WriteOnly)) {
+        qDebug() << QString("Open %1 failed: %2").arg(newSavePath).arg(target.errorString());
+        return savePath;
+    }
+
+    QByteArray buffer;
+    buffer.resize(SAVE_BUFFER_SIZE);
+    qint64 totalSize = source.size();
+    qint64 copiedSize = 0;
+    int lastProgress = 0;
+    while (true) {
+        qint64 size = source.read(buffer.data(), buffer.size());
+        if (size == 0) {
+            break;
+        }
+
+        if (size < 0 || target.write(buffer.constData(), size) != size) {
+            qDebug() << QString("Copy %1 to %2 failed: %3").arg(savePath).arg(newSavePath).arg(size < 0 ? source.errorString() : target.errorString());
+            target.close();
+            target.remove();
+            return savePath;
+        }
+
+        // Report every 10 percent, don't flood notification daemon.
+        copiedSize += size;
+        int progress = totalSize > 0 ? copiedSize * 100 / totalSize : 100;
+        if (progress / 10 != lastProgress / 10) {
+            reportFinalizeProgress(FINALIZE_PROGRESS_ENCODED + progress * (100 - FINALIZE_PROGRESS_ENCODED) / 100);
+        }
+        lastProgress = progress;
+    }
+
+    target.close();
+    source.close();
+    source.remove();
+
+    return newSavePath;
+}
 
-    process->start("byzanz-record", arguments);
+void RecordProcess::reportFinalizeProgress(int progress)
+{
+    // Replay mode and canceled record have no saving notification.
+    if (!replayMode && !isCanceled.load()) {
+        emit finalizeProgress(progress);
+    }
+}
+
+void RecordProcess::encodeGIF()
+{
+    initSavePath();
+
+    QFile file(savePath);
+    bool isFileOpened = file.open(QIODevice::WriteOnly);
+    if (!isFileOpened) {
+        qDebug() << QString("Open %1 failed: %2").arg(savePath).arg(file.errorString());
+    }
+
+    int width = recordPipeline.getWidth();
+    int height = recordPipeline.getHeight();
+    GifWriter writer(&file);
+    if (isFileOpened) {
+        writer.writeHeader(width, height);
+    }
+
+    // Frames are encoded in thread pool, encoder only hold copy of changed area,
+    // so previous pipeline frame is recycled once next frame is added.
+    // Keep draining pipeline even if file can't write, otherwise capture stage can't recycle frames.
+    GifEncoder encoder(&writer);
+    qint64 frameCounter = 0;
+    qint64 lastFrameTimestamp = 0;
+    int lastFrameIndex = -1;
+    PipelineFrame frame;
+    while (recordPipeline.popFrame(frame)) {
+        if (isFileOpened) {
+            const unsigned char *previous = lastFrameIndex >= 0 ? recordPipeline.getFrame(lastFrameIndex) : NULL;
+            if (encoder.addFrame(recordPipeline.getFrame(frame.index), previous, width * 4, width, height, frame.timestamp)) {
+                frameCounter++;
+            }
+        }
+
+        if (lastFrameIndex >= 0) {
+            recordPipeline.recycleFrame(lastFrameIndex);
+        }
+        lastFrameIndex = frame.index;
+        lastFrameTimestamp = frame.timestamp;
+    }
+
+    if (lastFrameIndex >= 0) {
+        recordPipeline.recycleFrame(lastFrameIndex);
+    }
+
+    // Last frame display until record end.
+    reportFinalizeProgress(FINALIZE_PROGRESS_ENCODING);
+    encoder.finish(qMax(recordPipeline.getLastTimestamp(), lastFrameTimestamp) + 1000000000LL / RECORD_GIF_FRAME_RATE);
+    qDebug() << QString("Encoded GIF with %1 threads").arg(encoder.getThreadNum());
+
+    if (isFileOpened) {
+        writer.writeTrailer();
+        file.close();
+    }
+    reportFinalizeProgress(FINALIZE_PROGRESS_ENCODED);
+
+    recordPipeline.wait();
+    recordPipeline.finishEncode(frameCounter);
+    recordPipeline.printStatistics();
 }
 
 void RecordProcess::recordVideo()
@@ -113,28 +352,193 @@ void RecordProcess::recordVideo()
 
     // FFmpeg need pass arugment split two part: -option value,
     // otherwise, it will report 'Unrecognized option' error.
+    //
+    // Screen is captured and converted by RecordPipeline in our process,
+    // ffmpeg just read raw I420 frames from stdin and encode them.
+    // Frames are wrapped in Matroska to carry capture timestamps,
+    // and '-vsync vfr' make ffmpeg keep them instead of resample to constant frame rate.
+    //
+    // Encode progress is written to stdout as 'key=value' lines, we use it to trace encoder when stopping.
+    // In replay mode stdout is MPEG-TS stream instead, key frame every 2 seconds split it to segments,
+    // and zero latency tune with packet flush make packet come out as soon as frame is encoded.
     QStringList arguments;
-    arguments << QString("-video_size");
-    arguments << QString("%1x%2").arg(recordWidth).arg(recordHeight);
-    arguments << QString("-framerate");
-    arguments << QString("25");
+    arguments << QString("-nostats");
+    if (!replayMode) {
+        arguments << QString("-progress");
+        arguments << QString("pipe:1");
+    }
     arguments << QString("-f");
-    arguments << QString("x11grab");
+    arguments << QString("matroska");
     arguments << QString("-i");
-    arguments << QString(":0.0+%1,%2").arg(recordX).arg(recordY);
-    arguments << savePath;
+    arguments << QString("pipe:0");
+    arguments << QString("-vsync");
+    arguments << QString("vfr");
+    if (replayMode) {
+        arguments << QString("-c:v");
+        arguments << QString("libx264");
+        arguments << QString("-preset");
+        arguments << QString("veryfast");
+        arguments << QString("-tune");
+        arguments << QString("zerolatency");
+        arguments << QString("-force_key_frames");
+        arguments << QString("expr:gte(t,n_forced*2)");
+        arguments << QString("-flush_packets");
+        arguments << QString("1");
+        arguments << QString("-f");
+        arguments << QString("mpegts");
+        arguments << QString("pipe:1");
+    } else {
+        arguments << savePath;
+    }
 
     process->start("ffmpeg", arguments);
 }
 
+void RecordProcess::encodeVideo()
+{
+    bool isEncoderStarted = process->waitForStarted(-1);
+    if (!isEncoderStarted) {
+        qDebug() << "Start ffmpeg failed:" << process->errorString();
+    }
+
+    MatroskaWriter writer(process);
+    if (isEncoderStarted) {
+        writer.writeHeader(recordPipeline.getWidth(), recordPipeline.getHeight(), "I420");
+    }
+
+    // Keep draining pipeline even if ffmpeg failed, otherwise capture stage can't recycle frames.
+    // Last frame is held until next frame arrived, we need write it again if duplicate frames at end are skipped.
+    int frameSize = recordPipeline.getFrameSize();
+    qint64 frameCounter = 0;
+    qint64 lastFrameTimestamp = 0;
+    int lastFrameIndex = -1;
+    PipelineFrame frame;
+    bool isTimeout = false;
+    while (recordPipeline.popFrame(frame, replayMode ? ENCODER_DRAIN_INTERVAL : -1, &isTimeout) || isTimeout) {
+        // No frame come when screen is static, but replay stream of last frames is still in pipe,
+        // read it now, otherwise it's missing in saved replay.
+        if (isTimeout) {
+            if (isEncoderStarted) {
+                process->waitForReadyRead(0);
+                readEncoderProgress();
+            }
+            continue;
+        }
+
+        if (isEncoderStarted) {
+            // Push frame to ffmpeg, wait pipe drain before take next frame.
+            writer.writeFrame(recordPipeline.getFrame(frame.index), frameSize, frame.timestamp);
+            waitProcessWritten();
+
+            frameCounter++;
+        }
+
+        if (lastFrameIndex >= 0) {
+            recordPipeline.recycleFrame(lastFrameIndex);
+        }
+        lastFrameIndex = frame.index;
+        lastFrameTimestamp = frame.timestamp;
+    }
+
+    if (lastFrameIndex >= 0) {
+        // Repeat last frame at end time, otherwise video stop at last changed frame.
+        if (isEncoderStarted && recordPipeline.getLastTimestamp() > lastFrameTimestamp) {
+            writer.writeFrame(recordPipeline.getFrame(lastFrameIndex), frameSize, recordPipeline.getLastTimestamp());
+            waitProcessWritten();
+        }
+
+        recordPipeline.recycleFrame(lastFrameIndex);
+    }
+
+    recordPipeline.wait();
+    recordPipeline.finishEncode(frameCounter);
+    recordPipeline.printStatistics();
+}
+
+void RecordProcess::waitProcessWritten()
+{
+    while (process->bytesToWrite() > 0) {
+        if (!process->waitForBytesWritten(-1)) {
+            break;
+        }
+    }
+
+    // Drain progress report, otherwise it pile up in QProcess buffer until record finished.
+    readEncoderProgress();
+}
+
+void RecordProcess::stopEncoder()
+{
+    // FFmpeg read frames from stdin, so it can't get 'q' command from stdin,
+    // EOF of input is same as 'q' for it: flush encoder, write file index and exit.
+    // Signal is only sent when ffmpeg miss deadline, SIGTERM still let ffmpeg write trailer,
+    // SIGKILL is last choice and file may be broken.
+    QElapsedTimer timer;
+    timer.start();
+
+    process->closeWriteChannel();
+
+    bool isFinished = waitEncoderFinished(encoderStopTimeout);
+    if (!isFinished) {
+        qDebug() << QString("Encoder not finished in %1 ms, terminate it.").arg(encoderStopTimeout);
+        process->terminate();
+        isFinished = waitEncoderFinished(ENCODER_KILL_TIMEOUT);
+    }
+    if (!isFinished) {
+        qDebug() << QString("Encoder not terminated in %1 ms, kill it.").arg(ENCODER_KILL_TIMEOUT);
+        process->kill();
+        process->waitForFinished(-1);
+    }
+
+    qDebug() << QString("Encoder stopped in %1 ms, encoded %2 frames").arg(timer.elapsed()).arg(encoderFrameNum);
+}
+
+bool RecordProcess::waitEncoderFinished(int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    while (process->state() != QProcess::NotRunning) {
+        qint64 remainTime = timeout - timer.elapsed();
+        if (remainTime <= 0) {
+            return false;
+        }
+
+        process->waitForReadyRead(qMin(remainTime, 100LL));
+        readEncoderProgress();
+    }
+
+    readEncoderProgress();
+    return true;
+}
+
+void RecordProcess::readEncoderProgress()
+{
+    if (replayMode) {
+        replayBuffer.append(process->readAllStandardOutput());
+        return;
+    }
+
+    while (process->canReadLine()) {
+        QByteArray line = process->readLine().trimmed();
+        if (line.startsWith("frame=")) {
+            encoderFrameNum = line.mid(6).toLongLong();
+        }
+    }
+}
+
 void RecordProcess::initProcess() {
     // Create process and handle finish signal.
     process = new QProcess();
     connect(process, SIGNAL(finished(int)), process, SLOT(deleteLater()));
 
+    initSavePath();
+}
+
+void RecordProcess::initSavePath()
+{
     // Build temp save path.
-    QDateTime date = QDateTime::currentDateTime();
-    saveBaseName = QString("%1_%2_%3.%4").arg(tr("deepin-screen-recorder")).arg(saveAreaName).arg(date.toString("yyyyMMddhhmmss")).arg(recordType == RECORD_TYPE_GIF ? "gif" : "mp4");
+    saveBaseName = buildSaveBaseName(recordType == RECORD_TYPE_GIF ? "gif" : "mp4");
     savePath = QDir(saveTempDir).filePath(saveBaseName);
 
     // Remove same cache file first.
@@ -142,54 +546,208 @@ void RecordProcess::initProcess() {
     file.remove();
 }
 
+QString RecordProcess::buildSaveBaseName(QString suffix)
+{
+    QDateTime date = QDateTime::currentDateTime();
+
+    return QString("%1_%2_%3.%4").arg(tr("deepin-screen-recorder")).arg(saveAreaName).arg(date.toString("yyyyMMddhhmmss")).arg(suffix);
+}
+
+void RecordProcess::prepareRecord()
+{
+    if (isPrepared) {
+        return;
+    }
+    isPrepared = true;
+
+    // Called when countdown start: allocate all frame memory, connect capture and start encoder,
+    // record loop won't allocate anything, and first frame is grabbed at the moment countdown finished.
+    int outputWidth;
+    int outputHeight;
+    FrameScaler::getOutputSize(recordWidth, recordHeight, outputScale, outputMaxWidth, outputMaxHeight, outputWidth, outputHeight);
+
+    if (recordType == RECORD_TYPE_GIF) {
+        recordPipeline.init(recordX, recordY, recordWidth, recordHeight,
+                            captureMode == CAPTURE_MODE_DAMAGE, RECORD_GIF_FRAME_RATE,
+                            framePoolBudget, framePoolHugePage, RecordPipeline::OUTPUT_FORMAT_BGRA, outputWidth, outputHeight);
+    } else {
+        // Replay mode record all the time, only damage capture keep idle screen cheap.
+        recordPipeline.init(recordX, recordY, recordWidth, recordHeight,
+                            replayMode || captureMode == CAPTURE_MODE_DAMAGE, recordFrameRate,
+                            framePoolBudget, framePoolHugePage, RecordPipeline::OUTPUT_FORMAT_I420, outputWidth, outputHeight);
+    }
+    if (followWindowMode && recordWindow != XCB_NONE) {
+        recordPipeline.setFollowWindow(recordWindow);
+    }
+    recordPipeline.prepare();
+
+    // Encoder wait first frame in record thread.
+    QThread::start();
+}
+
 void RecordProcess::startRecord()
 {
+    prepareRecord();
+    recordPipeline.start();
+
     recordTime = new QTime();
     recordTime->start();
-    QThread::start();
+}
+
+void RecordProcess::cancelRecord()
+{
+    if (!isPrepared || isStopping) {
+        return;
+    }
+
+    // Countdown canceled, stop prepared pipeline and encoder, and remove temp file.
+    isCanceled = 1;
+    isStopping = true;
+    recordPipeline.stop();
+    wait();
+
+    QFile::remove(savePath);
 }
 
 void RecordProcess::stopRecord()
 {
-    // If record time less than 1 second, wait 1 second make sure generate gif file correctly.
-    int elapsedTime = recordTime->elapsed();
-    if (elapsedTime < RECORD_GIF_SLEEP_TIME && recordType == RECORD_TYPE_GIF) {
-        msleep(RECORD_GIF_SLEEP_TIME);
-        qDebug() << QString("Record time too short (%1), wait 1 second make sure generate gif file correctly.").arg(elapsedTime);
+    if (isStopping) {
+        return;
+    }
+    isStopping = true;
+
+    // Stop capture and return at once, record thread flush encoder and move file,
+    // then finishRecord is called in GUI thread.
+    recordPipeline.stop();
+
+    if (!replayMode) {
+        notificationId = notify(0, tr("Saving record"), QString("%1 %2").arg(tr("Saving to")).arg(saveDir), QStringList(), QVariantMap());
     }
-    
-    // Exit record process.
-    process->terminate();
+}
+
+void RecordProcess::saveReplay()
+{
+    QByteArray stream = replayBuffer.takeSnapshot();
+    if (stream.isEmpty()) {
+        qDebug() << "No replay to save yet";
+        return;
+    }
+
+    // Remux stream to MP4 without re-encoding, QProcess write stream to ffmpeg in background,
+    // so GUI thread and recording are not blocked.
+    // Write to temp file and rename it when remux succeed, so there is never a broken file in save directory.
+    QString path = QDir(saveDir).filePath(buildSaveBaseName("mp4"));
+    QString tempPath = QString("%1.part").arg(path);
+    QStringList arguments;
+    arguments << QString("-y");
+    arguments << QString("-f");
+    arguments << QString("mpegts");
+    arguments << QString("-i");
+    arguments << QString("pipe:0");
+    arguments << QString("-c");
+    arguments << QString("copy");
+    arguments << QString("-f");
+    arguments << QString("mp4");
+    arguments << tempPath;
+
+    QProcess *remuxProcess = new QProcess(this);
+    remuxProcesses.append(remuxProcess);
+    connect(remuxProcess, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this,
+            [=] (int exitCode, QProcess::ExitStatus exitStatus) {
+                if (exitStatus != QProcess::NormalExit || exitCode != 0 || !QFile::rename(tempPath, path)) {
+                    qDebug() << "Save replay failed:" << remuxProcess->readAllStandardError();
+                    QFile::remove(tempPath);
+                } else {
+                    QStringList actions;
+                    actions << "_open" << tr("View");
+
+                    QVariantMap hints;
+                    hints["x-deepin-action-_open"] = QString("xdg-open,%1").arg(path);
+
+                    notify(0, tr("Replay saved"), QString("%1 %2").arg(tr("Saved to")).arg(path), actions, hints);
+                }
+                remuxProcesses.removeOne(remuxProcess);
+                remuxProcess->deleteLater();
+
+                if (isQuitPending && remuxProcesses.isEmpty()) {
+                    QApplication::quit();
+                }
+            });
+
+    qDebug() << QString("Save replay of %1 ms (%2 bytes) to %3").arg(replayBuffer.getDuration()).arg(stream.size()).arg(path);
+    remuxProcess->start("ffmpeg", arguments);
+    if (!remuxProcess->waitForStarted()) {
+        qDebug() << "Start ffmpeg to save replay failed";
+        remuxProcesses.removeOne(remuxProcess);
+        remuxProcess->deleteLater();
+        return;
+    }
+    remuxProcess->write(stream);
+    remuxProcess->closeWriteChannel();
+}
+
+bool RecordProcess::isReplayMode()
+{
+    return replayMode;
+}
+
+void RecordProcess::updateSaveNotification(int progress)
+{
+    QString state = progress == FINALIZE_PROGRESS_ENCODING ? tr("encoding") : QString("%1%").arg(progress);
+    notificationId = notify(notificationId, tr("Saving record"), QString("%1 %2 (%3)").arg(tr("Saving to")).arg(saveDir).arg(state),
+                            QStringList(), QVariantMap());
+}
 
-    // Wait thread.
+void RecordProcess::finishRecord(QString path)
+{
+    // Record thread is returning from run() now.
     wait();
 
-    // Popup notify.
-    QDBusInterface notification("org.freedesktop.Notifications",
-                                "/org/freedesktop/Notifications",
-                                "org.freedesktop.Notifications",
-                                QDBusConnection::sessionBus());
+    if (path.isEmpty()) {
+        quitWhenSaved();
+        return;
+    }
 
     QStringList actions;
     actions << "_open" << tr("View");
 
-    QString newSavePath = QDir(saveDir).filePath(saveBaseName);
-    QFile::rename(savePath, newSavePath);
-
     QVariantMap hints;
-    hints["x-deepin-action-_open"] = QString("xdg-open,%1").arg(newSavePath);
+    hints["x-deepin-action-_open"] = QString("xdg-open,%1").arg(path);
+
+    notify(notificationId, tr("Record finished"), QString("%1 %2").arg(tr("Saved to")).arg(path), actions, hints);
 
+    quitWhenSaved();
+}
+
+void RecordProcess::quitWhenSaved()
+{
+    // Quit kill remux processes, wait them finish, last one quit application.
+    if (remuxProcesses.isEmpty()) {
+        QApplication::quit();
+    } else {
+        qDebug() << QString("Wait %1 replays saved before quit").arg(remuxProcesses.size());
+        isQuitPending = true;
+    }
+}
+
+unsigned int RecordProcess::notify(unsigned int replacesId, QString summary, QString body, QStringList actions, QVariantMap hints)
+{
+    // Popup notify, notification with same id is replaced.
+    QDBusInterface notification("org.freedesktop.Notifications",
+                                "/org/freedesktop/Notifications",
+                                "org.freedesktop.Notifications",
+                                QDBusConnection::sessionBus());
 
     QList<QVariant> arg;
     arg << (QCoreApplication::applicationName()) // appname
-        << ((unsigned int) 0)                    // id
+        << replacesId                            // id
         << QString("deepin-screen-recorder") // icon
-        << tr("Record finished")    // summary
-        << QString("%1 %2").arg(tr("Saved to")).arg(newSavePath) // body
+        << summary              // summary
+        << body                 // body
         << actions              // actions
         << hints                // hints
         << (int) -1;            // timeout
-    notification.callWithArgumentList(QDBus::AutoDetect, "Notify", arg);
+    QDBusReply<unsigned int> reply = notification.callWithArgumentList(QDBus::AutoDetect, "Notify", arg);
 
-    QApplication::quit();
+    return reply.isValid() ? reply.value() : replacesId;
 }
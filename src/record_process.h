@@ -22,7 +22,13 @@
  */ 
 
 #include <QThread>
+#include <QAtomicInt>
 #include <QProcess>
+#include <QTime>
+#include <QVariant>
+#include "window_manager.h"
+#include "record_pipeline.h"
+#include "replay_buffer.h"
 
 class RecordProcess : public QThread
 {
@@ -32,29 +38,98 @@ class RecordProcess : public QThread
 public:
     static const int RECORD_TYPE_VIDEO;
     static const int RECORD_TYPE_GIF;
-    static const int RECORD_GIF_SLEEP_TIME;
+    static const int RECORD_FRAME_RATE;
+    static const int RECORD_GIF_FRAME_RATE;
+    static const int CAPTURE_MODE_FULL;
+    static const int CAPTURE_MODE_DAMAGE;
+    static const int FRAME_POOL_BUDGET;
+    static const int SAVE_BUFFER_SIZE;
+    static const int ENCODER_STOP_TIMEOUT;
+    static const int ENCODER_KILL_TIMEOUT;
+    static const int ENCODER_DRAIN_INTERVAL;
+    static const int REPLAY_DURATION;
+    static const int REPLAY_MEMORY_LIMIT;
+    static const int FINALIZE_PROGRESS_ENCODING;
+    static const int FINALIZE_PROGRESS_ENCODED;
     
     RecordProcess(QObject *parent = 0);
     
-    void setRecordInfo(int recordX, int recordY, int record_width, int recordHeight, QString areaName, int screenWidth, int screenHeight);
+    // Return false if record area is empty after clamp to monitors.
+    bool setRecordInfo(int recordX, int recordY, int record_width, int recordHeight, QString areaName);
     void setRecordType(int recordType);
+    void setWindowManager(WindowManager *wm);
+    void setCaptureMode(int mode);
+
+    // Window that record area is snapped to, XCB_NONE if area is dragged by user.
+    void setRecordWindow(xcb_window_t window);
+    void prepareRecord();
     void startRecord();
     void stopRecord();
-    void recordGIF();
+    void cancelRecord();
+    void saveReplay();
+    bool isReplayMode();
+    void encodeGIF();
     void recordVideo();
+    void encodeVideo();
+    void waitProcessWritten();
+    void stopEncoder();
+    bool waitEncoderFinished(int timeout);
+    void readEncoderProgress();
     void initProcess();
+    void initSavePath();
+    QString buildSaveBaseName(QString suffix);
+    QString moveSaveFile();
+    void reportFinalizeProgress(int progress);
+    void quitWhenSaved();
+    unsigned int notify(unsigned int replacesId, QString summary, QString body, QStringList actions, QVariantMap hints);
+
+signals:
+    // Percent of encoder flush and file move, FINALIZE_PROGRESS_ENCODING while encoder is flushing.
+    void finalizeProgress(int progress);
+    void finalizeFinished(QString path);
+
+public slots:
+    void updateSaveNotification(int progress);
+    void finishRecord(QString path);
 
 protected:
     void run();
 
 private:
     QProcess* process;
+    WindowManager* windowManager;
+
+    RecordPipeline recordPipeline;
+    qint64 framePoolBudget;
+    bool framePoolHugePage;
 
     int recordX;
     int recordY;
     int recordWidth;
     int recordHeight;
     int recordType;
+
+    // Output is downscaled to scale percent of record area and fit in max size, zero max size means no limit.
+    int outputScale;
+    int outputMaxWidth;
+    int outputMaxHeight;
+
+    int captureMode;
+
+    // Record area follow window when it move or resize if 'follow_window' is enabled.
+    bool followWindowMode;
+    xcb_window_t recordWindow;
+    int recordFrameRate;
+    int encoderStopTimeout;
+    qint64 encoderFrameNum;
+
+    // Instant replay keep last seconds of encoded stream in memory instead of writing file.
+    bool replayMode;
+    ReplayBuffer replayBuffer;
+
+    // Replays that still remuxing, quit is deferred until they finished, or saved file is truncated.
+    QList<QProcess*> remuxProcesses;
+    bool isQuitPending;
     
     QString savePath;
     QString saveBaseName;
@@ -64,4 +139,10 @@ private:
     QString saveAreaName;
     
     QTime *recordTime;
+
+    bool isPrepared;
+    bool isStopping;
+    // Set in GUI thread, read in record thread.
+    QAtomicInt isCanceled;
+    unsigned int notificationId;
 };
@@ -0,0 +1,210 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <QMutexLocker>
+#include "replay_buffer.h"
+#include "frame_scheduler.h"
+
+const int ReplayBuffer::TS_PACKET_SIZE = 188;
+
+static const unsigned char TS_SYNC_BYTE = 0x47;
+static const int TS_PAT_PID = 0;
+
+ReplayBuffer::ReplayBuffer()
+{
+    maxDuration = 0;
+    maxSize = 0;
+    totalSize = 0;
+    pmtPid = -1;
+    hasPat = false;
+    hasPmt = false;
+    isWaitingKeyFrame = true;
+}
+
+void ReplayBuffer::init(qint64 duration, qint64 memoryLimit)
+{
+    QMutexLocker locker(&mutex);
+
+    maxDuration = duration;
+    maxSize = memoryLimit;
+    segments.clear();
+    totalSize = 0;
+    pendingData.clear();
+    programTable.clear();
+    pmtPid = -1;
+    hasPat = false;
+    hasPmt = false;
+    isWaitingKeyFrame = true;
+    isWaitingKeyFrame = true;
+}
+
+void ReplayBuffer::append(const QByteArray &data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    qint64 time = FrameScheduler::getMonotonicTime() / 1000000;
+
+    pendingData.append(data);
+    int offset = 0;
+    while (offset + TS_PACKET_SIZE <= pendingData.size()) {
+        // Resync if stream is broken.
+        if ((unsigned char) pendingData[offset] != TS_SYNC_BYTE) {
+            offset++;
+            continue;
+        }
+
+        appendPacket(pendingData.constData() + offset, time);
+        offset += TS_PACKET_SIZE;
+    }
+    pendingData.remove(0, offset);
+
+    dropSegments(time);
+}
+
+QByteArray ReplayBuffer::takeSnapshot()
+{
+    QMutexLocker locker(&mutex);
+
+    // Last segment is still growing, but it's complete up to last packet.
+    QByteArray snapshot;
+    if (segments.isEmpty() || !hasPmt) {
+        return snapshot;
+    }
+
+    snapshot.reserve(programTable.size() + totalSize);
+    snapshot.append(programTable);
+    foreach (const ReplaySegment &segment, segments) {
+        snapshot.append(segment.data);
+    }
+
+    return snapshot;
+}
+
+qint64 ReplayBuffer::getDuration()
+{
+    QMutexLocker locker(&mutex);
+
+    return segments.isEmpty() ? 0 : FrameScheduler::getMonotonicTime() / 1000000 - segments.first().startTime;
+}
+
+qint64 ReplayBuffer::getSize()
+{
+    QMutexLocker locker(&mutex);
+
+    return totalSize;
+}
+
+void ReplayBuffer::appendPacket(const char *packet, qint64 time)
+{
+    const unsigned char *bytes = (const unsigned char *) packet;
+    int pid = ((bytes[1] & 0x1F) << 8) | bytes[2];
+    bool isPayloadStart = bytes[1] & 0x40;
+    int adaptationControl = (bytes[3] >> 4) & 0x3;
+
+    if (isPayloadStart && (pid == TS_PAT_PID || pid == pmtPid)) {
+        parseProgramTable(packet);
+    }
+
+    // Random access indicator of adaptation field is set on key frame packet.
+    bool isKeyFrame = (adaptationControl & 0x2) && bytes[4] > 0 && (bytes[5] & 0x40);
+    if (isKeyFrame) {
+        ReplaySegment segment;
+        segment.startTime = time;
+        segments.append(segment);
+        isWaitingKeyFrame = false;
+    }
+
+    // Packets before first key frame can't be decoded.
+    if (isWaitingKeyFrame) {
+        return;
+    }
+
+    // Segment bigger than memory limit can't be kept (bitrate too high or key frame missing),
+    // drop it and wait next key frame, so memory is always bounded.
+    if (segments.last().data.size() + TS_PACKET_SIZE > maxSize) {
+        qDebug() << QString("Replay segment exceed %1 bytes, drop it and wait next key frame").arg(maxSize);
+        totalSize -= segments.last().data.size();
+        segments.removeLast();
+        isWaitingKeyFrame = true;
+        return;
+    }
+
+    segments.last().data.append(packet, TS_PACKET_SIZE);
+    totalSize += TS_PACKET_SIZE;
+}
+
+void ReplayBuffer::parseProgramTable(const char *packet)
+{
+    const unsigned char *bytes = (const unsigned char *) packet;
+    int pid = ((bytes[1] & 0x1F) << 8) | bytes[2];
+
+    if (pid == TS_PAT_PID && !hasPat) {
+        // Skip header, adaptation field and pointer field, then section header (8 bytes),
+        // first program with non-zero number has PMT pid.
+        // Adaptation field and pointer field are untrusted, reject packet if section header is out of it.
+        int offset = 4;
+        if ((bytes[3] >> 4) & 0x2) {
+            offset += 1 + bytes[4];
+        }
+        if (offset >= TS_PACKET_SIZE) {
+            return;
+        }
+        offset += 1 + bytes[offset];
+        if (offset + 3 > TS_PACKET_SIZE) {
+            return;
+        }
+
+        int sectionLength = ((bytes[offset + 1] & 0x0F) << 8) | bytes[offset + 2];
+        int end = qMin(offset + 3 + sectionLength - 4, TS_PACKET_SIZE);
+        for (int entry = offset + 8; entry + 4 <= end; entry += 4) {
+            int programNumber = (bytes[entry] << 8) | bytes[entry + 1];
+            if (programNumber != 0) {
+                pmtPid = ((bytes[entry + 2] & 0x1F) << 8) | bytes[entry + 3];
+                programTable.append(packet, TS_PACKET_SIZE);
+                hasPat = true;
+                break;
+            }
+        }
+    } else if (pid == pmtPid && hasPat && !hasPmt) {
+        programTable.append(packet, TS_PACKET_SIZE);
+        hasPmt = true;
+    }
+}
+
+void ReplayBuffer::dropSegments(qint64 time)
+{
+    // Keep segment that cover start of replay window, and always keep newest segment.
+    while (segments.size() > 1 && segments[1].startTime <= time - maxDuration) {
+        totalSize -= segments.first().data.size();
+        segments.removeFirst();
+    }
+
+    while (segments.size() > 1 && totalSize > maxSize) {
+        totalSize -= segments.first().data.size();
+        segments.removeFirst();
+    }
+}
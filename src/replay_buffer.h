@@ -0,0 +1,86 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+
+// Segment start at key frame, so it can be decoded without earlier data.
+struct ReplaySegment {
+    // Monotonic time (milliseconds) when key frame arrived.
+    qint64 startTime;
+    QByteArray data;
+};
+
+// Keep last seconds of MPEG-TS stream from encoder in memory.
+// Stream is split at video key frames (random access indicator), oldest segments are dropped
+// when they are out of duration or memory limit, so saved replay always start with key frame.
+// Segment that alone exceed memory limit is dropped too.
+class ReplayBuffer
+{
+public:
+    static const int TS_PACKET_SIZE;
+
+    ReplayBuffer();
+
+    // Duration is milliseconds, memory limit is bytes.
+    void init(qint64 duration, qint64 memoryLimit);
+
+    // Stream data in any size, called by encoder thread.
+    void append(const QByteArray &data);
+
+    // Program tables and all complete segments, empty if no key frame yet.
+    QByteArray takeSnapshot();
+
+    qint64 getDuration();
+    qint64 getSize();
+
+private:
+    void appendPacket(const char *packet, qint64 time);
+    void parseProgramTable(const char *packet);
+    void dropSegments(qint64 time);
+
+    qint64 maxDuration;
+    qint64 maxSize;
+
+    QMutex mutex;
+    QList<ReplaySegment> segments;
+    qint64 totalSize;
+
+    // Incomplete packet of last append.
+    QByteArray pendingData;
+
+    // First PAT and PMT packets, written before segments when saving.
+    QByteArray programTable;
+    int pmtPid;
+    bool hasPat;
+    bool hasPmt;
+
+    // Open segment is dropped when it exceed memory limit, packets are ignored until next key frame.
+    bool isWaitingKeyFrame;
+};
+
+#endif
@@ -0,0 +1,454 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDebug>
+#include <algorithm>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "screen_capture.h"
+#include "frame_scheduler.h"
+
+const int ScreenCapture::DAMAGE_MAX_RECTS = 64;
+
+ScreenCapture::ScreenCapture()
+{
+    conn = NULL;
+    drawable = XCB_NONE;
+    currentBuffer = 0;
+    frameTime = 0;
+
+    isDamageMode = false;
+    needFullFrame = false;
+    damage = XCB_NONE;
+    damageRegion = XCB_NONE;
+    frameBuffer = NULL;
+
+    for (int i = 0; i < 2; i++) {
+        buffers[i].seg = XCB_NONE;
+        buffers[i].shmId = -1;
+        buffers[i].data = NULL;
+        pending[i] = false;
+        requestTimes[i] = 0;
+    }
+}
+
+ScreenCapture::~ScreenCapture()
+{
+    release();
+}
+
+bool ScreenCapture::init(xcb_connection_t *connection, xcb_window_t window, int x, int y, int width, int height)
+{
+    conn = connection;
+    drawable = window;
+    captureX = x;
+    captureY = y;
+    captureWidth = width;
+    captureHeight = height;
+
+    xcb_shm_query_version_reply_t *versionReply = xcb_shm_query_version_reply(conn, xcb_shm_query_version(conn), NULL);
+    if (!versionReply) {
+        qDebug() << "MIT-SHM extension is not available";
+        return false;
+    }
+    free(versionReply);
+
+    // We copy ZPixmap data as BGRA directly, so only accept 32 bits per pixel format.
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, xcb_get_geometry(conn, drawable), NULL);
+    if (!geometry) {
+        return false;
+    }
+    int depth = geometry->depth;
+    free(geometry);
+
+    int bitsPerPixel = 0;
+    int scanlinePad = 0;
+    xcb_format_iterator_t formatIter = xcb_setup_pixmap_formats_iterator(xcb_get_setup(conn));
+    for (; formatIter.rem; xcb_format_next(&formatIter)) {
+        if (formatIter.data->depth == depth) {
+            bitsPerPixel = formatIter.data->bits_per_pixel;
+            scanlinePad = formatIter.data->scanline_pad;
+            break;
+        }
+    }
+    if (bitsPerPixel != 32) {
+        qDebug() << QString("Unsupported pixmap format: depth %1, %2 bits per pixel").arg(depth).arg(bitsPerPixel);
+        return false;
+    }
+
+    int padBytes = scanlinePad / 8;
+    stride = (captureWidth * 4 + padBytes - 1) / padBytes * padBytes;
+
+    for (int i = 0; i < 2; i++) {
+        if (!attachBuffer(buffers[i])) {
+            release();
+            return false;
+        }
+    }
+
+    // Queue first request, it will finish when caller ask first frame.
+    currentBuffer = 0;
+    requestFrame(currentBuffer);
+
+    return true;
+}
+
+void ScreenCapture::release()
+{
+    releaseDamage();
+
+    for (int i = 0; i < 2; i++) {
+        if (pending[i]) {
+            xcb_discard_reply(conn, cookies[i].sequence);
+            pending[i] = false;
+        }
+
+        detachBuffer(buffers[i]);
+    }
+}
+
+void ScreenCapture::releaseDamage()
+{
+    if (damage != XCB_NONE) {
+        xcb_damage_destroy(conn, damage);
+        damage = XCB_NONE;
+    }
+
+    if (damageRegion != XCB_NONE) {
+        xcb_xfixes_destroy_region(conn, damageRegion);
+        damageRegion = XCB_NONE;
+    }
+
+    if (frameBuffer) {
+        free(frameBuffer);
+        frameBuffer = NULL;
+    }
+
+    isDamageMode = false;
+}
+
+bool ScreenCapture::attachBuffer(ShmBuffer &buffer)
+{
+    size_t size = (size_t) stride * captureHeight;
+
+    buffer.shmId = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (buffer.shmId < 0) {
+        qDebug() << "shmget failed";
+        return false;
+    }
+
+    buffer.data = (unsigned char *) shmat(buffer.shmId, NULL, 0);
+    if (buffer.data == (unsigned char *) -1) {
+        qDebug() << "shmat failed";
+        buffer.data = NULL;
+        shmctl(buffer.shmId, IPC_RMID, NULL);
+        buffer.shmId = -1;
+        return false;
+    }
+
+    buffer.seg = xcb_generate_id(conn);
+    xcb_generic_error_t *error = xcb_request_check(conn, xcb_shm_attach_checked(conn, buffer.seg, buffer.shmId, 0));
+
+    // Segment will destroy automatically after X server and us both detach it.
+    shmctl(buffer.shmId, IPC_RMID, NULL);
+
+    if (error) {
+        qDebug() << "xcb_shm_attach failed, error code:" << error->error_code;
+        free(error);
+        buffer.seg = XCB_NONE;
+        return false;
+    }
+
+    return true;
+}
+
+void ScreenCapture::detachBuffer(ShmBuffer &buffer)
+{
+    if (buffer.seg != XCB_NONE) {
+        xcb_shm_detach(conn, buffer.seg);
+        xcb_flush(conn);
+        buffer.seg = XCB_NONE;
+    }
+
+    if (buffer.data) {
+        shmdt(buffer.data);
+        buffer.data = NULL;
+    }
+
+    buffer.shmId = -1;
+}
+
+void ScreenCapture::requestFrame(int index)
+{
+    cookies[index] = xcb_shm_get_image(conn, drawable,
+                                       captureX, captureY, captureWidth, captureHeight,
+                                       ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                       buffers[index].seg, 0);
+    requestTimes[index] = FrameScheduler::getMonotonicTime();
+    pending[index] = true;
+    xcb_flush(conn);
+}
+
+bool ScreenCapture::enableDamage()
+{
+    xcb_damage_query_version_reply_t *damageVersion = xcb_damage_query_version_reply(
+        conn, xcb_damage_query_version(conn, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION), NULL);
+    if (!damageVersion) {
+        qDebug() << "DAMAGE extension is not available";
+        return false;
+    }
+    free(damageVersion);
+
+    // XFixes version must be negotiated before use region requests.
+    xcb_xfixes_query_version_reply_t *xfixesVersion = xcb_xfixes_query_version_reply(
+        conn, xcb_xfixes_query_version(conn, XCB_XFIXES_MAJOR_VERSION, XCB_XFIXES_MINOR_VERSION), NULL);
+    if (!xfixesVersion) {
+        qDebug() << "XFIXES extension is not available";
+        return false;
+    }
+    free(xfixesVersion);
+
+    frameBuffer = (unsigned char *) malloc((size_t) stride * captureHeight);
+    if (!frameBuffer) {
+        return false;
+    }
+
+    // Create damage object before grab first full frame,
+    // make sure we won't lost any change that happened after first frame.
+    damage = xcb_generate_id(conn);
+    xcb_damage_create(conn, damage, drawable, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+    damageRegion = xcb_generate_id(conn);
+    xcb_xfixes_create_region(conn, damageRegion, 0, NULL);
+
+    for (int i = 0; i < 2; i++) {
+        if (pending[i]) {
+            xcb_discard_reply(conn, cookies[i].sequence);
+            pending[i] = false;
+        }
+    }
+
+    xcb_generic_error_t *error = NULL;
+    xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(
+        conn,
+        xcb_shm_get_image(conn, drawable, captureX, captureY, captureWidth, captureHeight,
+                          ~0, XCB_IMAGE_FORMAT_Z_PIXMAP, buffers[0].seg, 0),
+        &error);
+    if (error || !reply) {
+        qDebug() << "Grab first frame failed";
+        free(error);
+        releaseDamage();
+        return false;
+    }
+    free(reply);
+
+    memcpy(frameBuffer, buffers[0].data, (size_t) stride * captureHeight);
+
+    isDamageMode = true;
+
+    return true;
+}
+
+const unsigned char* ScreenCapture::grabFrame()
+{
+    if (isDamageMode) {
+        return grabDamagedFrame();
+    }
+
+    int readyBuffer = currentBuffer;
+    if (!pending[readyBuffer]) {
+        requestFrame(readyBuffer);
+    }
+
+    xcb_generic_error_t *error = NULL;
+    xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(conn, cookies[readyBuffer], &error);
+    pending[readyBuffer] = false;
+    frameTime = requestTimes[readyBuffer];
+
+    // Send next request before return, X server will fill it while caller handle current frame.
+    currentBuffer = 1 - currentBuffer;
+    requestFrame(currentBuffer);
+
+    if (error) {
+        qDebug() << "xcb_shm_get_image failed, error code:" << error->error_code;
+        free(error);
+        return NULL;
+    }
+
+    if (!reply) {
+        return NULL;
+    }
+    free(reply);
+
+    return buffers[readyBuffer].data;
+}
+
+const unsigned char* ScreenCapture::grabDamagedFrame()
+{
+    // Move accumulated damage to region and clear damage object in one request.
+    frameTime = FrameScheduler::getMonotonicTime();
+    xcb_damage_subtract(conn, damage, XCB_NONE, damageRegion);
+    xcb_xfixes_fetch_region_reply_t *regionReply = xcb_xfixes_fetch_region_reply(conn, xcb_xfixes_fetch_region(conn, damageRegion), NULL);
+    if (!regionReply) {
+        return NULL;
+    }
+
+    xcb_rectangle_t *rects = xcb_xfixes_fetch_region_rectangles(regionReply);
+    int rectNum = xcb_xfixes_fetch_region_rectangles_length(regionReply);
+
+    // Clip damaged rectangles with record area, and translate to record area coordinate.
+    damagedRects.clear();
+    int damagedArea = 0;
+    for (int i = 0; i < rectNum; i++) {
+        int x1 = std::max((int) rects[i].x, captureX);
+        int y1 = std::max((int) rects[i].y, captureY);
+        int x2 = std::min(rects[i].x + rects[i].width, captureX + captureWidth);
+        int y2 = std::min(rects[i].y + rects[i].height, captureY + captureHeight);
+
+        if (x2 > x1 && y2 > y1) {
+            xcb_rectangle_t rect;
+            rect.x = x1 - captureX;
+            rect.y = y1 - captureY;
+            rect.width = x2 - x1;
+            rect.height = y2 - y1;
+            damagedRects.append(rect);
+
+            damagedArea += rect.width * rect.height;
+        }
+    }
+    free(regionReply);
+
+    // One full request is cheaper than many small requests if most area changed,
+    // persistent frame is also invalid after capture area moved.
+    if (needFullFrame || damagedRects.size() > DAMAGE_MAX_RECTS || damagedArea * 2 > captureWidth * captureHeight) {
+        needFullFrame = false;
+
+        xcb_rectangle_t rect;
+        rect.x = 0;
+        rect.y = 0;
+        rect.width = captureWidth;
+        rect.height = captureHeight;
+
+        damagedRects.clear();
+        damagedRects.append(rect);
+    }
+
+    // Region rectangles never overlap, so all images can be packed into one segment.
+    // Send all requests first, then collect replies, only pay one round trip.
+    QVector<xcb_shm_get_image_cookie_t> rectCookies;
+    QVector<int> rectOffsets;
+    int offset = 0;
+    foreach (auto rect, damagedRects) {
+        rectCookies.append(xcb_shm_get_image(conn, drawable,
+                                             captureX + rect.x, captureY + rect.y, rect.width, rect.height,
+                                             ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                             buffers[0].seg, offset));
+        rectOffsets.append(offset);
+        offset += rect.width * 4 * rect.height;
+    }
+    xcb_flush(conn);
+
+    bool hasError = false;
+    for (int i = 0; i < damagedRects.size(); i++) {
+        xcb_generic_error_t *error = NULL;
+        xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(conn, rectCookies[i], &error);
+        if (error || !reply) {
+            free(error);
+            hasError = true;
+            continue;
+        }
+        free(reply);
+
+        const xcb_rectangle_t &rect = damagedRects[i];
+        const unsigned char *src = buffers[0].data + rectOffsets[i];
+        unsigned char *dst = frameBuffer + rect.y * stride + rect.x * 4;
+        int rowSize = rect.width * 4;
+        for (int row = 0; row < rect.height; row++) {
+            memcpy(dst, src, rowSize);
+            src += rowSize;
+            dst += stride;
+        }
+    }
+
+    if (hasError) {
+        qDebug() << "Grab damaged rectangles failed";
+        return NULL;
+    }
+
+    return frameBuffer;
+}
+
+bool ScreenCapture::isDamageEnabled()
+{
+    return isDamageMode;
+}
+
+const QVector<xcb_rectangle_t>& ScreenCapture::getDamagedRects()
+{
+    return damagedRects;
+}
+
+void ScreenCapture::moveTo(int x, int y)
+{
+    captureX = x;
+    captureY = y;
+
+    if (isDamageMode) {
+        needFullFrame = true;
+    } else if (pending[currentBuffer]) {
+        // Frame queued at old position is useless, queue it again.
+        xcb_discard_reply(conn, cookies[currentBuffer].sequence);
+        requestFrame(currentBuffer);
+    }
+}
+
+qint64 ScreenCapture::getFrameTime()
+{
+    return frameTime;
+}
+
+int ScreenCapture::getX()
+{
+    return captureX;
+}
+
+int ScreenCapture::getY()
+{
+    return captureY;
+}
+
+int ScreenCapture::getWidth()
+{
+    return captureWidth;
+}
+
+int ScreenCapture::getHeight()
+{
+    return captureHeight;
+}
+
+int ScreenCapture::getStride()
+{
+    return stride;
+}
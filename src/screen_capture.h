@@ -0,0 +1,112 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCREENCAPTURE_H
+#define SCREENCAPTURE_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#include <xcb/damage.h>
+#include <xcb/xfixes.h>
+
+class ScreenCapture
+{
+public:
+    static const int DAMAGE_MAX_RECTS;
+
+    ScreenCapture();
+    ~ScreenCapture();
+
+    bool init(xcb_connection_t *connection, xcb_window_t window, int x, int y, int width, int height);
+    void release();
+
+    // Track screen changes with XDamage, grabFrame will only copy changed parts after enable.
+    // Damaged region is fetched by grabFrame, notify events are just wakeup hints,
+    // caller should drain them from connection.
+    bool enableDamage();
+
+    // Return last requested frame and queue request of next frame,
+    // so X server fill one buffer while we handle other one.
+    // Returned data is valid until next call.
+    //
+    // In damage mode, returned data is persistent frame that only damaged rectangles updated.
+    const unsigned char* grabFrame();
+
+    // Rectangles (in record area coordinate) updated by last grabFrame in damage mode,
+    // empty if screen not changed.
+    bool isDamageEnabled();
+    const QVector<xcb_rectangle_t>& getDamagedRects();
+
+    // Move capture area without change size, next returned frame is grabbed at new position.
+    void moveTo(int x, int y);
+
+    // CLOCK_MONOTONIC time (nanoseconds) when X server was asked to copy returned frame.
+    qint64 getFrameTime();
+
+    int getX();
+    int getY();
+    int getWidth();
+    int getHeight();
+    int getStride();
+
+private:
+    struct ShmBuffer {
+        xcb_shm_seg_t seg;
+        int shmId;
+        unsigned char *data;
+    };
+
+    bool attachBuffer(ShmBuffer &buffer);
+    void detachBuffer(ShmBuffer &buffer);
+    void requestFrame(int index);
+    const unsigned char* grabDamagedFrame();
+    void releaseDamage();
+
+    xcb_connection_t *conn;
+    xcb_window_t drawable;
+
+    // Double buffer, one for X server write, other one for reader.
+    ShmBuffer buffers[2];
+    xcb_shm_get_image_cookie_t cookies[2];
+    bool pending[2];
+    qint64 requestTimes[2];
+    qint64 frameTime;
+    int currentBuffer;
+
+    int captureX;
+    int captureY;
+    int captureWidth;
+    int captureHeight;
+    int stride;
+
+    bool isDamageMode;
+    bool needFullFrame;
+    xcb_damage_damage_t damage;
+    xcb_xfixes_region_t damageRegion;
+    QVector<xcb_rectangle_t> damagedRects;
+    unsigned char *frameBuffer;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QAtomicInt>
+#include <QVector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Producer only writes tail, consumer only writes head, so no lock is needed.
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(int capacity) : buffer(capacity + 1), head(0), tail(0)
+    {
+    }
+
+    bool push(const T &item)
+    {
+        int currentTail = tail.load();
+        int nextTail = next(currentTail);
+        if (nextTail == head.loadAcquire()) {
+            return false;
+        }
+
+        buffer[currentTail] = item;
+        tail.storeRelease(nextTail);
+
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        int currentHead = head.load();
+        if (currentHead == tail.loadAcquire()) {
+            return false;
+        }
+
+        item = buffer[currentHead];
+        head.storeRelease(next(currentHead));
+
+        return true;
+    }
+
+    int size()
+    {
+        int count = tail.loadAcquire() - head.loadAcquire();
+        return count >= 0 ? count : count + buffer.size();
+    }
+
+    int getCapacity()
+    {
+        return buffer.size() - 1;
+    }
+
+private:
+    int next(int index)
+    {
+        return index + 1 == buffer.size() ? 0 : index + 1;
+    }
+
+    QVector<T> buffer;
+
+    // Keep head and tail in different cache lines, avoid producer and consumer fight for same line.
+    alignas(64) QAtomicInt head;
+    alignas(64) QAtomicInt tail;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "window_index.h"
+
+const int WindowIndex::CELL_SIZE = 64;
+
+WindowIndex::WindowIndex()
+{
+    columns = 0;
+    rows = 0;
+}
+
+void WindowIndex::build(const QList<WindowRect> &rects, int screenWidth, int screenHeight)
+{
+    windowRects = rects;
+    columns = std::max((screenWidth + CELL_SIZE - 1) / CELL_SIZE, 1);
+    rows = std::max((screenHeight + CELL_SIZE - 1) / CELL_SIZE, 1);
+
+    cells.clear();
+    cells.resize(columns * rows);
+
+    // Append rects in stacking order, so indexes in every cell keep sorted from top to bottom.
+    for (int i = 0; i < rects.size(); i++) {
+        const WindowRect &rect = rects[i];
+        if (rect.width <= 0 || rect.height <= 0) {
+            continue;
+        }
+
+        int left = std::max(rect.x / CELL_SIZE, 0);
+        int top = std::max(rect.y / CELL_SIZE, 0);
+        int right = std::min((rect.x + rect.width - 1) / CELL_SIZE, columns - 1);
+        int bottom = std::min((rect.y + rect.height - 1) / CELL_SIZE, rows - 1);
+
+        for (int row = top; row <= bottom; row++) {
+            for (int column = left; column <= right; column++) {
+                cells[row * columns + column].append(i);
+            }
+        }
+    }
+}
+
+int WindowIndex::find(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= columns * CELL_SIZE || y >= rows * CELL_SIZE) {
+        return -1;
+    }
+
+    foreach (auto i, cells[(y / CELL_SIZE) * columns + x / CELL_SIZE]) {
+        const WindowRect &rect = windowRects[i];
+        if (x > rect.x && x < rect.x + rect.width && y > rect.y && y < rect.y + rect.height) {
+            return i;
+        }
+    }
+
+    return -1;
+}
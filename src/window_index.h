@@ -0,0 +1,53 @@
+/* -*- Mode: C++; indent-tabs-mode: nil; tab-width: 4 -*-
+ * -*- coding: utf-8 -*-
+ *
+ * Copyright (C) 2011 ~ 2017 Deepin, Inc.
+ *               2011 ~ 2017 Wang Yong
+ *
+ * Author:     Wang Yong <wangyong@deepin.com>
+ * Maintainer: Wang Yong <wangyong@deepin.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WINDOWINDEX_H
+#define WINDOWINDEX_H
+
+#include <QList>
+#include <QVector>
+#include "window_manager.h"
+
+// Uniform grid over screen, every cell keep indexes of rects overlap it in stacking order,
+// so find topmost rect under cursor only check few rects of one cell.
+class WindowIndex
+{
+public:
+    static const int CELL_SIZE;
+
+    WindowIndex();
+
+    // Rects must sort from top to bottom, area outside screen is ignored.
+    void build(const QList<WindowRect> &rects, int screenWidth, int screenHeight);
+
+    // Return index of topmost rect contains point (border not included), or -1 if no rect found.
+    int find(int x, int y) const;
+
+private:
+    QList<WindowRect> windowRects;
+    QVector<QVector<int>> cells;
+    int columns;
+    int rows;
+};
+
+#endif
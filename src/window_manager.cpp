@@ -21,34 +21,60 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <QObject>
 #include <QDebug>
+#include <QSet>
+#include <QVector>
 #include <QtX11Extras/QX11Info>
 #include <xcb/xcb.h>
 #include <xcb/xcb_aux.h>
+#include <xcb/randr.h>
+#include <xcb/composite.h>
 #include "window_manager.h"
 
+const int WindowManager::SUB_WINDOW_MAX_DEPTH = 4;
+
 WindowManager::WindowManager(QObject *parent) : QObject(parent)
 {
     int screenNum;
     conn = xcb_connect(0, &screenNum);
     xcb_screen_t* screen = xcb_aux_get_screen(conn, screenNum);
     rootWindow = screen->root;
+
+    watchConn = NULL;
+    watchNotifier = NULL;
+    ignoreWindow = XCB_NONE;
+    watchCurrentDesktop = 0;
+
+    // Intern all atoms we use in one batch, avoid round trip when get window properties.
+    internAtoms(QStringList()
+                << "_NET_CLIENT_LIST_STACKING" << "_NET_CURRENT_DESKTOP" << "_NET_WM_DESKTOP"
+                << "_NET_WM_NAME" << "_NET_WM_WINDOW_TYPE" << "_NET_WM_STATE"
+                << "_NET_WM_WINDOW_TYPE_NORMAL" << "_NET_WM_WINDOW_TYPE_DIALOG" << "_NET_WM_STATE_HIDDEN"
+                << "_GTK_FRAME_EXTENTS" << "_NET_WM_DEEPIN_BLUR_REGION_ROUNDED"
+                << "WM_CLASS" << "STRING" << "UTF8_STRING");
 }
 
 WindowManager::~WindowManager()
 {
-    delete conn;
+    stopWatchWindows();
+    xcb_disconnect(conn);
 }
 
 xcb_atom_t WindowManager::getAtom(QString name)
 {
+    if (atoms.contains(name)) {
+        return atoms.value(name);
+    }
+
     QByteArray rawName = name.toLatin1();
     xcb_atom_t result = XCB_ATOM_NONE;
     xcb_intern_atom_cookie_t cookie = xcb_intern_atom(conn, 0, rawName.size(), rawName.data());
     xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookie, NULL);
     if(reply) {
         result = reply->atom;
+        cacheAtom(name, result);
 
         free(reply);
     }
@@ -56,6 +82,12 @@ xcb_atom_t WindowManager::getAtom(QString name)
     return result;
 }
 
+void WindowManager::cacheAtom(const QString &name, xcb_atom_t atom)
+{
+    atoms.insert(name, atom);
+    atomNames.insert(atom, name);
+}
+
 xcb_get_property_reply_t* WindowManager::getProperty(xcb_window_t window, QString propertyName, xcb_atom_t type)
 {
     xcb_get_property_cookie_t cookie = xcb_get_property(conn, 0, window, getAtom(propertyName), type, 0, UINT32_MAX);
@@ -64,6 +96,10 @@ xcb_get_property_reply_t* WindowManager::getProperty(xcb_window_t window, QStrin
 
 QString WindowManager::getAtomName(xcb_atom_t atom)
 {
+    if (atomNames.contains(atom)) {
+        return atomNames.value(atom);
+    }
+
     QString result;
 
     xcb_get_atom_name_cookie_t cookie = xcb_get_atom_name(conn, atom);
@@ -71,199 +107,682 @@ QString WindowManager::getAtomName(xcb_atom_t atom)
 
     if (reply) {
         result = QString::fromLatin1(xcb_get_atom_name_name(reply), xcb_get_atom_name_name_length(reply));
+        cacheAtom(result, atom);
         free(reply);
     }
 
     return result;
 }
 
-QStringList WindowManager::getWindowTypes(xcb_window_t window)
+QString WindowManager::getWindowName(xcb_window_t window)
 {
-    QStringList types;
-    xcb_get_property_reply_t *reply = getProperty(window, "_NET_WM_WINDOW_TYPE", XCB_ATOM_ATOM);
+    if (window == rootWindow) {
+        return tr("Desktop");
+    } else {
+        xcb_get_property_reply_t *reply = getProperty(window, "_NET_WM_NAME", getAtom("UTF8_STRING"));
 
-    if(reply) {
-        xcb_atom_t *typesA = static_cast<xcb_atom_t*>(xcb_get_property_value(reply));
-        int typeNum = reply->length;
+        if(reply) {
+            QString result = QString::fromUtf8(static_cast<char*>(xcb_get_property_value(reply)), xcb_get_property_value_length(reply));
 
-        for(int i = 0; i < typeNum; i++) {
-            types.append(getAtomName(typesA[i]));
+            free(reply);
+
+            return result;
+        } else {
+            return QString();
         }
+    }
+}
 
-        free(reply);
+QVector<xcb_atom_t> WindowManager::internAtoms(const QStringList &names)
+{
+    // Only intern atoms not in cache, all requests are sent before wait any reply.
+    QStringList missingNames;
+    QVector<xcb_intern_atom_cookie_t> cookies;
+    foreach (auto name, names) {
+        if (!atoms.contains(name) && !missingNames.contains(name)) {
+            QByteArray rawName = name.toLatin1();
+            missingNames.append(name);
+            cookies.append(xcb_intern_atom(conn, 0, rawName.size(), rawName.data()));
+        }
+    }
+
+    for (int i = 0; i < cookies.size(); i++) {
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookies[i], NULL);
+        if (reply) {
+            cacheAtom(missingNames[i], reply->atom);
+            free(reply);
+        }
     }
 
-    return types;
+    QVector<xcb_atom_t> result;
+    foreach (auto name, names) {
+        result.append(atoms.value(name, XCB_ATOM_NONE));
+    }
+
+    return result;
 }
 
-QStringList WindowManager::getWindowStates(xcb_window_t window)
+QList<WindowInfo> WindowManager::getWindowInfos()
 {
-    QStringList types;
-    xcb_get_property_reply_t *reply = getProperty(window, "_NET_WM_STATE", XCB_ATOM_ATOM);
+    xcb_get_geometry_cookie_t rootGeometryCookie = xcb_get_geometry(conn, rootWindow);
+
+    QVector<xcb_window_t> stacking;
+    int currentDesktop = readClientList(conn, stacking);
+    QVector<WindowState> states = readWindowStates(conn, stacking);
+
+    WindowRect rootRect;
+    rootRect.x = 0;
+    rootRect.y = 0;
+    rootRect.width = 0;
+    rootRect.height = 0;
+    xcb_get_geometry_reply_t *rootGeometry = xcb_get_geometry_reply(conn, rootGeometryCookie, NULL);
+    if (rootGeometry) {
+        rootRect.width = rootGeometry->width;
+        rootRect.height = rootGeometry->height;
+        free(rootGeometry);
+    }
 
-    if(reply) {
-        xcb_atom_t *typesA = static_cast<xcb_atom_t*>(xcb_get_property_value(reply));
-        int typeNum = reply->length;
+    QHash<xcb_window_t, WindowState> stateTable;
+    for (int i = 0; i < stacking.size(); i++) {
+        stateTable.insert(stacking[i], states[i]);
+    }
+
+    return buildWindowInfos(stacking, stateTable, currentDesktop, rootRect);
+}
 
-        for(int i = 0; i < typeNum; i++) {
-            types.append(getAtomName(typesA[i]));
+int WindowManager::readClientList(xcb_connection_t *connection, QVector<xcb_window_t> &stacking)
+{
+    xcb_get_property_cookie_t clientListCookie = xcb_get_property(connection, 0, rootWindow, getAtom("_NET_CLIENT_LIST_STACKING"), XCB_ATOM_WINDOW, 0, UINT32_MAX);
+    xcb_get_property_cookie_t currentDesktopCookie = xcb_get_property(connection, 0, rootWindow, getAtom("_NET_CURRENT_DESKTOP"), XCB_ATOM_CARDINAL, 0, UINT32_MAX);
+
+    stacking.clear();
+    xcb_get_property_reply_t *clientListReply = xcb_get_property_reply(connection, clientListCookie, NULL);
+    if (clientListReply) {
+        xcb_window_t *windowList = static_cast<xcb_window_t*>(xcb_get_property_value(clientListReply));
+        int windowListLength = xcb_get_property_value_length(clientListReply) / sizeof(xcb_window_t);
+        for (int i = 0; i < windowListLength; i++) {
+            stacking.append(windowList[i]);
         }
+        free(clientListReply);
+    }
 
-        free(reply);
+    int currentDesktop = 0;
+    xcb_get_property_reply_t *currentDesktopReply = xcb_get_property_reply(connection, currentDesktopCookie, NULL);
+    if (currentDesktopReply) {
+        if (xcb_get_property_value_length(currentDesktopReply) >= 4) {
+            currentDesktop = *((int *) xcb_get_property_value(currentDesktopReply));
+        }
+        free(currentDesktopReply);
     }
 
-    return types;
+    return currentDesktop;
 }
 
-QList<int> WindowManager::getWindowFrameExtents(xcb_window_t window)
+QVector<WindowManager::WindowState> WindowManager::readWindowStates(xcb_connection_t *connection, const QVector<xcb_window_t> &windows)
 {
-    QList<int> extents;
-
-    if (window != rootWindow) {
-        xcb_get_property_reply_t *gtkFrameReply = getProperty(window, "_GTK_FRAME_EXTENTS", XCB_ATOM_CARDINAL);
+    xcb_atom_t typeAtom = getAtom("_NET_WM_WINDOW_TYPE");
+    xcb_atom_t stateAtom = getAtom("_NET_WM_STATE");
+    xcb_atom_t desktopAtom = getAtom("_NET_WM_DESKTOP");
+    xcb_atom_t frameExtentsAtom = getAtom("_GTK_FRAME_EXTENTS");
+    xcb_atom_t normalTypeAtom = getAtom("_NET_WM_WINDOW_TYPE_NORMAL");
+    xcb_atom_t dialogTypeAtom = getAtom("_NET_WM_WINDOW_TYPE_DIALOG");
+    xcb_atom_t hiddenStateAtom = getAtom("_NET_WM_STATE_HIDDEN");
+
+    // Send requests of all windows, then collect replies in same order.
+    struct WindowCookies {
+        xcb_get_property_cookie_t type;
+        xcb_get_property_cookie_t state;
+        xcb_get_property_cookie_t desktop;
+        xcb_get_property_cookie_t frameExtents;
+        xcb_get_property_cookie_t wmClass;
+        xcb_get_geometry_cookie_t geometry;
+        xcb_translate_coordinates_cookie_t coordinate;
+    };
+    QVector<WindowCookies> cookies(windows.size());
+    for (int i = 0; i < windows.size(); i++) {
+        xcb_window_t window = windows[i];
+        cookies[i].type = xcb_get_property(connection, 0, window, typeAtom, XCB_ATOM_ATOM, 0, UINT32_MAX);
+        cookies[i].state = xcb_get_property(connection, 0, window, stateAtom, XCB_ATOM_ATOM, 0, UINT32_MAX);
+        cookies[i].desktop = xcb_get_property(connection, 0, window, desktopAtom, XCB_ATOM_CARDINAL, 0, UINT32_MAX);
+        cookies[i].frameExtents = xcb_get_property(connection, 0, window, frameExtentsAtom, XCB_ATOM_CARDINAL, 0, UINT32_MAX);
+        cookies[i].wmClass = xcb_get_property(connection, 0, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, UINT32_MAX);
+        cookies[i].geometry = xcb_get_geometry(connection, window);
+        cookies[i].coordinate = xcb_translate_coordinates(connection, window, rootWindow, 0, 0);
+    }
 
-        if (gtkFrameReply) {
-            // Because XCB haven't function to check property is exist,
-            // we will got wrong value if property '_GTK_FRAME_EXTENTS' is not exist in window xprop attributes.
-            // So we check reply->format, if it equal 16 or 32, '_GTK_FRAME_EXTENTS' property is exist.
-            if (gtkFrameReply->format == 32 || gtkFrameReply->format == 16) {
-                int32_t *value = (int32_t *)xcb_get_property_value(gtkFrameReply);
-                for (int i = 0; i < 4; ++i) {
-                    extents.append(value[i]);
+    QVector<WindowState> states(windows.size());
+    for (int i = 0; i < windows.size(); i++) {
+        xcb_get_property_reply_t *typeReply = xcb_get_property_reply(connection, cookies[i].type, NULL);
+        xcb_get_property_reply_t *stateReply = xcb_get_property_reply(connection, cookies[i].state, NULL);
+        xcb_get_property_reply_t *desktopReply = xcb_get_property_reply(connection, cookies[i].desktop, NULL);
+        xcb_get_property_reply_t *frameExtentsReply = xcb_get_property_reply(connection, cookies[i].frameExtents, NULL);
+        xcb_get_property_reply_t *wmClassReply = xcb_get_property_reply(connection, cookies[i].wmClass, NULL);
+        xcb_get_geometry_reply_t *geometryReply = xcb_get_geometry_reply(connection, cookies[i].geometry, NULL);
+        xcb_translate_coordinates_reply_t *coordinateReply = xcb_translate_coordinates_reply(connection, cookies[i].coordinate, NULL);
+
+        WindowState &state = states[i];
+        state.info.window = windows[i];
+        state.isNormal = false;
+        state.isHidden = false;
+        state.desktop = 0;
+
+        // Window may already be destroyed.
+        state.isValid = geometryReply && coordinateReply;
+
+        if (typeReply) {
+            xcb_atom_t *types = static_cast<xcb_atom_t*>(xcb_get_property_value(typeReply));
+            int typeNum = xcb_get_property_value_length(typeReply) / sizeof(xcb_atom_t);
+            for (int j = 0; j < typeNum; j++) {
+                if (types[j] == normalTypeAtom || types[j] == dialogTypeAtom) {
+                    state.isNormal = true;
+                    break;
                 }
-            } else {
-                for (int j = 0; j < 4; ++j) {
-                    extents.append(0);
+            }
+        }
+
+        if (stateReply) {
+            xcb_atom_t *windowStates = static_cast<xcb_atom_t*>(xcb_get_property_value(stateReply));
+            int stateNum = xcb_get_property_value_length(stateReply) / sizeof(xcb_atom_t);
+            for (int j = 0; j < stateNum; j++) {
+                if (windowStates[j] == hiddenStateAtom) {
+                    state.isHidden = true;
+                    break;
                 }
             }
         }
 
-        free(gtkFrameReply);
+        if (desktopReply && xcb_get_property_value_length(desktopReply) >= 4) {
+            state.desktop = *((int *) xcb_get_property_value(desktopReply));
+        }
+
+        if (state.isValid) {
+            state.info.rect = buildWindowRect(geometryReply, coordinateReply, frameExtentsReply);
+        }
+
+        if (wmClassReply) {
+            QList<QByteArray> rawClasses = QByteArray(static_cast<char*>(xcb_get_property_value(wmClassReply)), xcb_get_property_value_length(wmClassReply)).split('\0');
+            state.info.className = QString::fromLatin1(rawClasses[0]);
+        }
+
+        free(typeReply);
+        free(stateReply);
+        free(desktopReply);
+        free(frameExtentsReply);
+        free(wmClassReply);
+        free(geometryReply);
+        free(coordinateReply);
     }
 
-    return extents;
+    return states;
 }
 
-QString WindowManager::getWindowClass(xcb_window_t window)
+QList<WindowInfo> WindowManager::buildWindowInfos(const QVector<xcb_window_t> &stacking, const QHash<xcb_window_t, WindowState> &stateTable,
+                                                  int currentDesktop, const WindowRect &rootRect)
 {
-    if (window == rootWindow) {
-        return tr("Desktop");
-    } else {
-        xcb_get_property_reply_t *reply = getProperty(window, "WM_CLASS", getAtom("STRING"));
-
-        if(reply) {
-            QList<QByteArray> rawClasses = QByteArray(static_cast<char*>(xcb_get_property_value(reply)), xcb_get_property_value_length(reply)).split('\0');
+    QList<WindowInfo> infos;
 
-            free(reply);
+    // Only normal and dialog windows that not hidden and on current workspace,
+    // walk stacking list from up to bottom, to make compare cursor with window area from up to bottom.
+    for (int i = stacking.size() - 1; i >= 0; i--) {
+        if (stacking[i] == ignoreWindow || !stateTable.contains(stacking[i])) {
+            continue;
+        }
 
-            return QString::fromLatin1(rawClasses[0]);
-        } else {
-            return QString();
+        const WindowState &state = stateTable[stacking[i]];
+        if (state.isValid && state.isNormal && !state.isHidden && state.desktop == currentDesktop) {
+            infos.append(state.info);
         }
     }
+
+    // Add desktop window.
+    WindowInfo desktopInfo;
+    desktopInfo.window = rootWindow;
+    desktopInfo.rect = rootRect;
+    desktopInfo.className = tr("Desktop");
+    infos.append(desktopInfo);
+
+    return infos;
 }
 
-QString WindowManager::getWindowName(xcb_window_t window)
+// Append sub windows of window from top to bottom, every sub window is above its parent.
+static void appendSubWindows(xcb_window_t window, const QHash<xcb_window_t, QList<WindowInfo> > &subWindows, QList<WindowInfo> &infos)
 {
-    if (window == rootWindow) {
-        return tr("Desktop");
-    } else {
-        xcb_get_property_reply_t *reply = getProperty(window, "_NET_WM_NAME", getAtom("UTF8_STRING"));
+    foreach (auto subWindow, subWindows.value(window)) {
+        appendSubWindows(subWindow.window, subWindows, infos);
+        infos.append(subWindow);
+    }
+}
 
-        if(reply) {
-            QString result = QString::fromUtf8(static_cast<char*>(xcb_get_property_value(reply)), xcb_get_property_value_length(reply));
+QHash<xcb_window_t, QList<WindowInfo> > WindowManager::getSubWindows(const QList<WindowInfo> &windows, int minSize)
+{
+    // Sub windows of every listed window, from top to bottom.
+    QHash<xcb_window_t, QList<WindowInfo> > subWindows;
+
+    // Windows to query children in this level, listed window that their sub windows belong to,
+    // and top level window they are in.
+    QVector<WindowInfo> parents;
+    QVector<xcb_window_t> owners;
+    QVector<xcb_window_t> clients;
+    foreach (auto info, windows) {
+        if (info.window != rootWindow) {
+            parents.append(info);
+            owners.append(info.window);
+            clients.append(info.window);
+        }
+    }
 
-            free(reply);
+    // Query one level of all windows every round, requests of same level are sent together.
+    for (int depth = 0; depth < SUB_WINDOW_MAX_DEPTH && !parents.isEmpty(); depth++) {
+        // Children created, mapped or resized later are reported to watch connection,
+        // top level windows already select SubstructureNotify in watchClients.
+        // Select before query tree, so no change is missed between them.
+        if (watchConn && depth > 0) {
+            uint32_t subWindowMask = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+            for (int i = 0; i < parents.size(); i++) {
+                xcb_change_window_attributes(watchConn, parents[i].window, XCB_CW_EVENT_MASK, &subWindowMask);
+                watchedSubWindows.insert(parents[i].window, clients[i]);
+            }
+            xcb_aux_sync(watchConn);
+        }
 
-            return result;
-        } else {
-            return QString();
+        QVector<xcb_query_tree_cookie_t> treeCookies;
+        foreach (auto parent, parents) {
+            treeCookies.append(xcb_query_tree(conn, parent.window));
+        }
+
+        struct ChildCookies {
+            int parent;
+            xcb_window_t window;
+            xcb_get_window_attributes_cookie_t attributes;
+            xcb_get_geometry_cookie_t geometry;
+            xcb_translate_coordinates_cookie_t coordinate;
+        };
+        QVector<ChildCookies> cookies;
+        for (int i = 0; i < treeCookies.size(); i++) {
+            xcb_query_tree_reply_t *tree = xcb_query_tree_reply(conn, treeCookies[i], NULL);
+            if (!tree) {
+                continue;
+            }
+
+            xcb_window_t *children = xcb_query_tree_children(tree);
+            int childNum = xcb_query_tree_children_length(tree);
+            for (int j = 0; j < childNum; j++) {
+                ChildCookies childCookies;
+                childCookies.parent = i;
+                childCookies.window = children[j];
+                childCookies.attributes = xcb_get_window_attributes(conn, children[j]);
+                childCookies.geometry = xcb_get_geometry(conn, children[j]);
+                childCookies.coordinate = xcb_translate_coordinates(conn, children[j], rootWindow, 0, 0);
+                cookies.append(childCookies);
+            }
+            free(tree);
+        }
+
+        QVector<WindowInfo> nextParents;
+        QVector<xcb_window_t> nextOwners;
+        QVector<xcb_window_t> nextClients;
+        foreach (auto childCookies, cookies) {
+            xcb_get_window_attributes_reply_t *attributes = xcb_get_window_attributes_reply(conn, childCookies.attributes, NULL);
+            xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, childCookies.geometry, NULL);
+            xcb_translate_coordinates_reply_t *coordinate = xcb_translate_coordinates_reply(conn, childCookies.coordinate, NULL);
+
+            if (attributes && geometry && coordinate &&
+                attributes->map_state == XCB_MAP_STATE_VIEWABLE && attributes->_class == XCB_WINDOW_CLASS_INPUT_OUTPUT) {
+                const WindowInfo &parent = parents[childCookies.parent];
+                xcb_window_t owner = owners[childCookies.parent];
+
+                // Only visible part in parent.
+                int x = std::max((int) coordinate->dst_x, parent.rect.x);
+                int y = std::max((int) coordinate->dst_y, parent.rect.y);
+                int right = std::min(coordinate->dst_x + geometry->width, parent.rect.x + parent.rect.width);
+                int bottom = std::min(coordinate->dst_y + geometry->height, parent.rect.y + parent.rect.height);
+
+                WindowInfo info;
+                info.window = childCookies.window;
+                info.rect.x = x;
+                info.rect.y = y;
+                info.rect.width = right - x;
+                info.rect.height = bottom - y;
+                info.className = parent.className;
+
+                if (info.rect.width >= minSize && info.rect.height >= minSize) {
+                    // Child fill whole parent is not a new area, its sub windows belong to listed parent.
+                    if (info.rect.x != parent.rect.x || info.rect.y != parent.rect.y ||
+                        info.rect.width != parent.rect.width || info.rect.height != parent.rect.height) {
+                        // Children are reported from bottom to top.
+                        subWindows[owner].prepend(info);
+                        owner = info.window;
+                    }
+
+                    nextParents.append(info);
+                    nextOwners.append(owner);
+                    nextClients.append(clients[childCookies.parent]);
+                }
+            }
+
+            free(attributes);
+            free(geometry);
+            free(coordinate);
         }
+
+        parents = nextParents;
+        owners = nextOwners;
+        clients = nextClients;
+    }
+
+    QHash<xcb_window_t, QList<WindowInfo> > infos;
+    foreach (auto info, windows) {
+        QList<WindowInfo> windowSubWindows;
+        appendSubWindows(info.window, subWindows, windowSubWindows);
+        infos.insert(info.window, windowSubWindows);
     }
+
+    return infos;
 }
 
-int WindowManager::getCurrentWorkspace(xcb_window_t window)
+void WindowManager::startWatchWindows(xcb_window_t window)
 {
-    xcb_get_property_reply_t *reply = getProperty(window, "_NET_CURRENT_DESKTOP", XCB_ATOM_CARDINAL);
-    int desktop = 0;
+    if (watchConn) {
+        return;
+    }
 
-    if (reply) {
-        desktop = *((int *) xcb_get_property_value(reply));
+    // Watch events with another connection, events of main connection are consumed by record thread.
+    watchConn = xcb_connect(0, NULL);
+    if (xcb_connection_has_error(watchConn)) {
+        qDebug() << "Connect X server failed, window list will not update.";
 
-        free(reply);
+        xcb_disconnect(watchConn);
+        watchConn = NULL;
+        return;
     }
 
-    return desktop;
+    ignoreWindow = window;
+    watchRootRect = getRootWindowRect();
+
+    uint32_t eventMask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+    xcb_change_window_attributes(watchConn, rootWindow, XCB_CW_EVENT_MASK, &eventMask);
+
+    // Select events before read windows, so no change is missed between them.
+    watchCurrentDesktop = readClientList(watchConn, watchStacking);
+    watchClients(watchStacking);
+    QVector<WindowState> states = readWindowStates(watchConn, watchStacking);
+    changedWindows.clear();
+    treeChangedWindows.clear();
+    for (int i = 0; i < watchStacking.size(); i++) {
+        watchStates.insert(watchStacking[i], states[i]);
+        changedWindows.insert(watchStacking[i]);
+    }
+    windowSnapshot = buildWindowInfos(watchStacking, watchStates, watchCurrentDesktop, watchRootRect);
+
+    watchNotifier = new QSocketNotifier(xcb_get_file_descriptor(watchConn), QSocketNotifier::Read, this);
+    connect(watchNotifier, SIGNAL(activated(int)), this, SLOT(handleWatchEvents()));
+
+    // Events may already queued when read replies.
+    handleWatchEvents();
 }
 
-int WindowManager::getWindowWorkspace(xcb_window_t window)
+void WindowManager::stopWatchWindows()
 {
-    if (window == rootWindow) {
-        return getCurrentWorkspace(rootWindow);
-    } else {
-        xcb_get_property_reply_t *reply = getProperty(window, "_NET_WM_DESKTOP", XCB_ATOM_CARDINAL);
-        int desktop = 0;
+    if (!watchConn) {
+        return;
+    }
 
-        if (reply) {
-            desktop = *((int *) xcb_get_property_value(reply));
+    delete watchNotifier;
+    watchNotifier = NULL;
 
-            free(reply);
+    xcb_disconnect(watchConn);
+    watchConn = NULL;
+
+    watchStacking.clear();
+    watchStates.clear();
+    watchedWindows.clear();
+    watchedSubWindows.clear();
+    changedWindows.clear();
+    treeChangedWindows.clear();
+}
+
+QList<WindowInfo> WindowManager::getWindowSnapshot()
+{
+    // List is implicitly shared, copy is cheap until model change.
+    if (!watchConn) {
+        return getWindowInfos();
+    }
+
+    return windowSnapshot;
+}
+
+QSet<xcb_window_t> WindowManager::getChangedWindows()
+{
+    return changedWindows;
+}
+
+QSet<xcb_window_t> WindowManager::getTreeChangedWindows()
+{
+    return treeChangedWindows;
+}
+
+void WindowManager::watchClients(const QVector<xcb_window_t> &clients)
+{
+    // Reparenting window manager move frame window, client window don't get real ConfigureNotify,
+    // so watch all ancestors below root too.
+    // Walk one level of all clients every round, requests of same level are sent together.
+    // SubstructureNotify of client report its child windows changed, sub windows need read again.
+    uint32_t clientMask = XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
+    uint32_t frameMask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+    QVector<xcb_window_t> windows;
+    QVector<xcb_window_t> owners;
+    foreach (auto client, clients) {
+        if (client != XCB_NONE && client != rootWindow) {
+            windows.append(client);
+            owners.append(client);
         }
+    }
 
-        return desktop;
+    while (!windows.isEmpty()) {
+        QVector<xcb_query_tree_cookie_t> cookies;
+        for (int i = 0; i < windows.size(); i++) {
+            xcb_change_window_attributes(watchConn, windows[i], XCB_CW_EVENT_MASK, windows[i] == owners[i] ? &clientMask : &frameMask);
+            watchedWindows.insert(windows[i], owners[i]);
+            cookies.append(xcb_query_tree(watchConn, windows[i]));
+        }
+
+        QVector<xcb_window_t> parents;
+        QVector<xcb_window_t> parentOwners;
+        for (int i = 0; i < cookies.size(); i++) {
+            xcb_query_tree_reply_t *tree = xcb_query_tree_reply(watchConn, cookies[i], NULL);
+            if (!tree) {
+                continue;
+            }
+
+            if (tree->parent != XCB_NONE && tree->parent != rootWindow) {
+                parents.append(tree->parent);
+                parentOwners.append(owners[i]);
+            }
+            free(tree);
+        }
+
+        windows = parents;
+        owners = parentOwners;
     }
 }
 
-QList<xcb_window_t> WindowManager::getWindows()
+void WindowManager::unwatchClient(xcb_window_t client)
 {
-    QList<xcb_window_t> windows;
-    xcb_get_property_reply_t *listReply = getProperty(rootWindow, "_NET_CLIENT_LIST_STACKING", XCB_ATOM_WINDOW);
+    QMutableHashIterator<xcb_window_t, xcb_window_t> iter(watchedWindows);
+    while (iter.hasNext()) {
+        iter.next();
+        if (iter.value() == client) {
+            iter.remove();
+        }
+    }
 
-    if (listReply) {
-        xcb_window_t *windowList = static_cast<xcb_window_t*>(xcb_get_property_value(listReply));
-        int windowListLength = listReply->length;
+    QMutableHashIterator<xcb_window_t, xcb_window_t> subWindowIter(watchedSubWindows);
+    while (subWindowIter.hasNext()) {
+        subWindowIter.next();
+        if (subWindowIter.value() == client) {
+            subWindowIter.remove();
+        }
+    }
+}
 
-        for (int i = 0; i < windowListLength; i++) {
-            xcb_window_t window = windowList[i];
-
-            foreach(QString type, getWindowTypes(window)) {
-                if (type == "_NET_WM_WINDOW_TYPE_NORMAL" ||
-                    type == "_NET_WM_WINDOW_TYPE_DIALOG"
-                    ) {
-                    bool needAppend = false;
-
-                    QStringList states = getWindowStates(window);
-                    if (states.length() == 0 ||
-                        (!states.contains("_NET_WM_STATE_HIDDEN"))) {
-                        if (getWindowWorkspace(window) == getCurrentWorkspace(rootWindow)) {
-                            needAppend = true;
-                        }
-                    }
+xcb_window_t WindowManager::getSubWindowClient(xcb_window_t parent)
+{
+    if (watchStates.contains(parent)) {
+        return parent;
+    }
 
-                    if (needAppend) {
-                        windows.append(window);
-                        break;
-                    }
+    return watchedSubWindows.value(parent, XCB_NONE);
+}
+
+void WindowManager::handleWatchEvents()
+{
+    if (!watchConn) {
+        return;
+    }
+
+    xcb_atom_t clientListAtom = getAtom("_NET_CLIENT_LIST_STACKING");
+    xcb_atom_t currentDesktopAtom = getAtom("_NET_CURRENT_DESKTOP");
+
+    // Only properties that readWindowStates use, title and user time change too often.
+    QSet<xcb_atom_t> stateAtoms;
+    stateAtoms.insert(getAtom("_NET_WM_WINDOW_TYPE"));
+    stateAtoms.insert(getAtom("_NET_WM_STATE"));
+    stateAtoms.insert(getAtom("_NET_WM_DESKTOP"));
+    stateAtoms.insert(getAtom("_GTK_FRAME_EXTENTS"));
+
+    bool needReadClientList = false;
+    QSet<xcb_window_t> dirtyClients;
+    QSet<xcb_window_t> reparentedClients;
+    // Clients that child window in them created, destroyed, mapped, unmapped or configured.
+    QSet<xcb_window_t> subWindowChangedClients;
+
+    xcb_generic_event_t *event;
+    while ((event = xcb_poll_for_event(watchConn)) != NULL) {
+        switch (event->response_type & ~0x80) {
+        case XCB_PROPERTY_NOTIFY: {
+            xcb_property_notify_event_t *propertyEvent = (xcb_property_notify_event_t *) event;
+            if (propertyEvent->window == rootWindow) {
+                if (propertyEvent->atom == clientListAtom || propertyEvent->atom == currentDesktopAtom) {
+                    needReadClientList = true;
                 }
+            } else if (watchStates.contains(propertyEvent->window) && stateAtoms.contains(propertyEvent->atom)) {
+                dirtyClients.insert(propertyEvent->window);
+            }
+            break;
+        }
+        case XCB_CONFIGURE_NOTIFY: {
+            xcb_configure_notify_event_t *configureEvent = (xcb_configure_notify_event_t *) event;
+            if (configureEvent->event != configureEvent->window) {
+                subWindowChangedClients.insert(getSubWindowClient(configureEvent->event));
+            } else if (watchedWindows.contains(configureEvent->window)) {
+                dirtyClients.insert(watchedWindows.value(configureEvent->window));
+            }
+            break;
+        }
+        case XCB_REPARENT_NOTIFY: {
+            // Frame of client changed, watch new ancestors.
+            xcb_reparent_notify_event_t *reparentEvent = (xcb_reparent_notify_event_t *) event;
+            if (reparentEvent->event != reparentEvent->window) {
+                subWindowChangedClients.insert(getSubWindowClient(reparentEvent->event));
+            } else if (watchStates.contains(reparentEvent->window)) {
+                unwatchClient(reparentEvent->window);
+                reparentedClients.insert(reparentEvent->window);
+                dirtyClients.insert(reparentEvent->window);
+            }
+            break;
+        }
+        case XCB_CREATE_NOTIFY: {
+            xcb_create_notify_event_t *createEvent = (xcb_create_notify_event_t *) event;
+            subWindowChangedClients.insert(getSubWindowClient(createEvent->parent));
+            break;
+        }
+        case XCB_MAP_NOTIFY: {
+            xcb_map_notify_event_t *mapEvent = (xcb_map_notify_event_t *) event;
+            if (mapEvent->event != mapEvent->window) {
+                subWindowChangedClients.insert(getSubWindowClient(mapEvent->event));
+            }
+            break;
+        }
+        case XCB_UNMAP_NOTIFY: {
+            xcb_unmap_notify_event_t *unmapEvent = (xcb_unmap_notify_event_t *) event;
+            if (unmapEvent->event != unmapEvent->window) {
+                subWindowChangedClients.insert(getSubWindowClient(unmapEvent->event));
+            }
+            break;
+        }
+        case XCB_DESTROY_NOTIFY: {
+            xcb_destroy_notify_event_t *destroyEvent = (xcb_destroy_notify_event_t *) event;
+            if (destroyEvent->event != destroyEvent->window) {
+                subWindowChangedClients.insert(getSubWindowClient(destroyEvent->event));
             }
+            watchedWindows.remove(destroyEvent->window);
+            watchedSubWindows.remove(destroyEvent->window);
+            break;
+        }
         }
 
-        free(listReply);
+        free(event);
     }
 
-    // We need re-sort windows list from up to bottom,
-    // to make compare cursor with window area from up to bottom.
-    std::reverse(windows.begin(), windows.end());
+    subWindowChangedClients.remove(XCB_NONE);
+    if (!needReadClientList && dirtyClients.isEmpty() && subWindowChangedClients.isEmpty()) {
+        return;
+    }
 
-    // Add desktop window.
-    windows.append(rootWindow);
+    QVector<xcb_window_t> newClients;
+    if (needReadClientList) {
+        int currentDesktop = readClientList(watchConn, watchStacking);
 
-    // Just use for debug.
-    // foreach (auto window, windows) {
-    //     qDebug() << getWindowName(window);
-    // }
+        QSet<xcb_window_t> clients;
+        foreach (auto client, watchStacking) {
+            clients.insert(client);
 
-    return windows;
+            if (!watchStates.contains(client)) {
+                newClients.append(client);
+                dirtyClients.insert(client);
+            }
+        }
+
+        foreach (auto client, watchStates.keys()) {
+            if (!clients.contains(client)) {
+                unwatchClient(client);
+                watchStates.remove(client);
+                dirtyClients.remove(client);
+            }
+        }
+
+        watchCurrentDesktop = currentDesktop;
+    }
+
+    // Watch ancestors of new and reparented clients in one batch.
+    treeChangedWindows.clear();
+    foreach (auto client, reparentedClients) {
+        if (watchStates.contains(client)) {
+            newClients.append(client);
+            treeChangedWindows.insert(client);
+        }
+    }
+    foreach (auto client, subWindowChangedClients) {
+        if (watchStates.contains(client)) {
+            treeChangedWindows.insert(client);
+        }
+    }
+    watchClients(newClients);
+
+    // Only read windows that changed.
+    QVector<xcb_window_t> windows;
+    foreach (auto client, dirtyClients) {
+        windows.append(client);
+    }
+    QVector<WindowState> states = readWindowStates(watchConn, windows);
+    for (int i = 0; i < windows.size(); i++) {
+        watchStates.insert(windows[i], states[i]);
+    }
+
+    windowSnapshot = buildWindowInfos(watchStacking, watchStates, watchCurrentDesktop, watchRootRect);
+    changedWindows = dirtyClients;
+
+    emit windowsChanged();
 }
 
 WindowRect WindowManager::getRootWindowRect() {
@@ -280,6 +799,71 @@ WindowRect WindowManager::getRootWindowRect() {
     return rect;
 }
 
+static bool containsRect(const WindowRect &outer, const WindowRect &inner)
+{
+    return inner.x >= outer.x && inner.y >= outer.y &&
+        inner.x + inner.width <= outer.x + outer.width &&
+        inner.y + inner.height <= outer.y + outer.height;
+}
+
+QList<WindowRect> WindowManager::getMonitorRects()
+{
+    QList<WindowRect> rects;
+
+    xcb_randr_get_screen_resources_current_reply_t *resources = xcb_randr_get_screen_resources_current_reply(
+        conn, xcb_randr_get_screen_resources_current(conn, rootWindow), NULL);
+    if (resources) {
+        xcb_randr_crtc_t *crtcs = xcb_randr_get_screen_resources_current_crtcs(resources);
+        int crtcNum = xcb_randr_get_screen_resources_current_crtcs_length(resources);
+
+        // Send all requests before wait any reply, so we only pay one round trip.
+        QVector<xcb_randr_get_crtc_info_cookie_t> cookies(crtcNum);
+        for (int i = 0; i < crtcNum; i++) {
+            cookies[i] = xcb_randr_get_crtc_info(conn, crtcs[i], resources->config_timestamp);
+        }
+
+        for (int i = 0; i < crtcNum; i++) {
+            xcb_randr_get_crtc_info_reply_t *info = xcb_randr_get_crtc_info_reply(conn, cookies[i], NULL);
+            if (!info) {
+                continue;
+            }
+
+            // Disabled CRTC has no mode.
+            if (info->mode != XCB_NONE && info->width > 0 && info->height > 0) {
+                WindowRect rect;
+                rect.x = info->x;
+                rect.y = info->y;
+                rect.width = info->width;
+                rect.height = info->height;
+
+                // Mirrored outputs show same content, only keep the biggest one.
+                bool isClone = false;
+                for (int j = rects.length() - 1; j >= 0; j--) {
+                    if (containsRect(rects[j], rect)) {
+                        isClone = true;
+                        break;
+                    } else if (containsRect(rect, rects[j])) {
+                        rects.removeAt(j);
+                    }
+                }
+                if (!isClone) {
+                    rects.append(rect);
+                }
+            }
+
+            free(info);
+        }
+
+        free(resources);
+    }
+
+    if (rects.isEmpty()) {
+        rects.append(getRootWindowRect());
+    }
+
+    return rects;
+}
+
 void WindowManager::translateCoords(xcb_window_t window, int32_t& x, int32_t& y)
 {
     xcb_translate_coordinates_cookie_t c = xcb_translate_coordinates(conn, rootWindow, window, x, y);
@@ -295,33 +879,145 @@ void WindowManager::translateCoords(xcb_window_t window, int32_t& x, int32_t& y)
 
 WindowRect WindowManager::getWindowRect(xcb_window_t window)
 {
+    xcb_get_geometry_cookie_t geometryCookie = xcb_get_geometry(conn, window);
+    xcb_translate_coordinates_cookie_t coordinateCookie = xcb_translate_coordinates(conn, window, rootWindow, 0, 0);
+    xcb_get_property_cookie_t extentsCookie = xcb_get_property(conn, 0, window, getAtom("_GTK_FRAME_EXTENTS"), XCB_ATOM_CARDINAL, 0, UINT32_MAX);
+
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, geometryCookie, NULL);
+    xcb_translate_coordinates_reply_t *coordinate = xcb_translate_coordinates_reply(conn, coordinateCookie, NULL);
+    xcb_get_property_reply_t *extents = xcb_get_property_reply(conn, extentsCookie, NULL);
+
     WindowRect rect;
 
-    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, xcb_get_geometry(conn, window), 0);
-    xcb_translate_coordinates_reply_t *coordinate = xcb_translate_coordinates_reply(conn, xcb_translate_coordinates(conn, window, rootWindow, 0, 0), 0);
+    // Window may already be destroyed.
+    if (!geometry || !coordinate) {
+        rect.x = 0;
+        rect.y = 0;
+        rect.width = 0;
+        rect.height = 0;
+    } else {
+        rect = buildWindowRect(geometry, coordinate, window != rootWindow ? extents : NULL);
+    }
+
+    free(geometry);
+    free(coordinate);
+    free(extents);
 
-    QList<int> extents = getWindowFrameExtents(window);
+    return rect;
+}
 
+WindowRect WindowManager::buildWindowRect(xcb_get_geometry_reply_t *geometry, xcb_translate_coordinates_reply_t *coordinate, xcb_get_property_reply_t *extents)
+{
+    WindowRect rect;
     rect.x = coordinate->dst_x;
     rect.y = coordinate->dst_y;
     rect.width = geometry->width;
     rect.height = geometry->height;
 
-    if (extents.length() == 4) {
-        // _GTK_FRAME_EXTENTS: left, right, top, bottom
-        rect.x += extents[0];
-        rect.y += extents[2];
-        rect.width -= extents[0] + extents[1];
-        rect.height -= extents[2] + extents[3];
+    // _GTK_FRAME_EXTENTS: left, right, top, bottom
+    // Because XCB haven't function to check property is exist,
+    // we check reply->format, if it equal 16 or 32, '_GTK_FRAME_EXTENTS' property is exist.
+    if (extents && (extents->format == 32 || extents->format == 16) && xcb_get_property_value_length(extents) >= 16) {
+        int32_t *value = (int32_t *) xcb_get_property_value(extents);
+        rect.x += value[0];
+        rect.y += value[2];
+        rect.width -= value[0] + value[1];
+        rect.height -= value[2] + value[3];
+    }
+
+    return rect;
+}
+
+QList<xcb_window_t> WindowManager::selectConfigureEvents(xcb_window_t window)
+{
+    QList<xcb_window_t> windows;
+
+    // Reparenting window manager move frame window, client window don't get real ConfigureNotify,
+    // so watch all ancestors below root too.
+    uint32_t eventMask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+    xcb_window_t current = window;
+    while (current != XCB_NONE && current != rootWindow) {
+        xcb_change_window_attributes(conn, current, XCB_CW_EVENT_MASK, &eventMask);
+        windows.append(current);
+
+        xcb_query_tree_reply_t *tree = xcb_query_tree_reply(conn, xcb_query_tree(conn, current), NULL);
+        if (!tree) {
+            break;
+        }
+        current = tree->parent;
+        free(tree);
+    }
+    xcb_flush(conn);
+
+    return windows;
+}
+
+bool WindowManager::redirectWindow(xcb_window_t window)
+{
+    xcb_composite_query_version_reply_t *version = xcb_composite_query_version_reply(
+        conn, xcb_composite_query_version(conn, XCB_COMPOSITE_MAJOR_VERSION, XCB_COMPOSITE_MINOR_VERSION), NULL);
+    if (!version) {
+        return false;
+    }
+    bool isSupported = version->major_version > 0 || version->minor_version >= 2;
+    free(version);
+
+    if (!isSupported) {
+        return false;
+    }
+
+    // Automatic redirection is allowed even if compositor already redirect window manually.
+    xcb_generic_error_t *error = xcb_request_check(conn, xcb_composite_redirect_window_checked(conn, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC));
+    if (error) {
+        qDebug() << "Redirect window failed, error code:" << error->error_code;
+        free(error);
+        return false;
+    }
+
+    return true;
+}
+
+void WindowManager::unredirectWindow(xcb_window_t window)
+{
+    xcb_composite_unredirect_window(conn, window, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_flush(conn);
+}
+
+xcb_pixmap_t WindowManager::nameWindowPixmap(xcb_window_t window, WindowRect &pixmapRect)
+{
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, xcb_get_geometry(conn, window), NULL);
+    xcb_translate_coordinates_reply_t *coordinate = xcb_translate_coordinates_reply(conn, xcb_translate_coordinates(conn, window, rootWindow, 0, 0), NULL);
+    if (!geometry || !coordinate) {
+        free(geometry);
+        free(coordinate);
+        return XCB_NONE;
     }
 
+    // Window origin is inside border, pixmap start from border.
+    pixmapRect.x = coordinate->dst_x - geometry->border_width;
+    pixmapRect.y = coordinate->dst_y - geometry->border_width;
+    pixmapRect.width = geometry->width + geometry->border_width * 2;
+    pixmapRect.height = geometry->height + geometry->border_width * 2;
     free(geometry);
     free(coordinate);
 
-    return rect;
+    xcb_pixmap_t pixmap = xcb_generate_id(conn);
+    xcb_generic_error_t *error = xcb_request_check(conn, xcb_composite_name_window_pixmap_checked(conn, window, pixmap));
+    if (error) {
+        qDebug() << "Name window pixmap failed, error code:" << error->error_code;
+        free(error);
+        return XCB_NONE;
+    }
+
+    return pixmap;
 }
 
 WindowRect WindowManager::adjustRectInScreenArea(WindowRect rect)
+{
+    return adjustRectInScreenArea(rect, getRootWindowRect());
+}
+
+WindowRect WindowManager::adjustRectInScreenArea(WindowRect rect, const WindowRect &rootWindowRect)
 {
     WindowRect newRect;
     newRect.x = rect.x >= 0 ? rect.x : 0;
@@ -329,8 +1025,6 @@ WindowRect WindowManager::adjustRectInScreenArea(WindowRect rect)
     newRect.width = rect.x >= 0 ? rect.width : rect.width + rect.x;
     newRect.height = rect.y >= 0 ? rect.height : rect.height + rect.y;
     
-    WindowRect rootWindowRect = getRootWindowRect();
-    
     if (newRect.x + newRect.width > rootWindowRect.width) {
         newRect.width = rootWindowRect.width - newRect.x;
     }
@@ -342,6 +1036,11 @@ WindowRect WindowManager::adjustRectInScreenArea(WindowRect rect)
     return newRect;
 }
 
+xcb_connection_t* WindowManager::getConnection()
+{
+    return conn;
+}
+
 template <typename... ArgTypes, typename... ArgTypes2>
 static inline unsigned int XcbCallVoid(xcb_void_cookie_t (*func)(xcb_connection_t *, ArgTypes...), ArgTypes2... args...)
 {
@@ -25,6 +25,11 @@
 #define WINDOWMANAGER_H
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QVector>
 #include <xcb/xcb.h>
 #include <xcb/xcb_aux.h>
 
@@ -35,35 +40,118 @@ struct WindowRect {
     int height;
 };
 
+struct WindowInfo {
+    xcb_window_t window;
+    WindowRect rect;
+    QString className;
+};
+
 class WindowManager : public QObject
 {
     Q_OBJECT
 
 public:
+    static const int SUB_WINDOW_MAX_DEPTH;
+
     WindowManager(QObject *parent = 0);
     ~WindowManager();
 
-    QList<int> getWindowFrameExtents(xcb_window_t window);
-    QList<xcb_window_t> getWindows();
+    // Normal and dialog windows on current workspace (top to bottom, desktop last) with rect and class,
+    // all requests are sent before wait any reply, so it only cost few round trips.
+    QList<WindowInfo> getWindowInfos();
+
+    // Keep window list update with X events after start watch, windowsChanged is emitted when list changed.
+    // Snapshot is same as getWindowInfos, but don't need talk with X server.
+    void startWatchWindows(xcb_window_t ignoreWindow = XCB_NONE);
+    void stopWatchWindows();
+    QList<WindowInfo> getWindowSnapshot();
+
+    // Top level windows that changed (moved, resized, type, state or workspace changed) in last windowsChanged.
+    QSet<xcb_window_t> getChangedWindows();
+
+    // Top level windows that reparented or their child windows changed in last windowsChanged,
+    // their sub windows need read again.
+    QSet<xcb_window_t> getTreeChangedWindows();
+
+    // Visible sub windows (clip by parent, not smaller than minSize) of every listed window,
+    // sorted from top to bottom and every sub window is above its parent. Sub windows use class of top level window.
+    QHash<xcb_window_t, QList<WindowInfo> > getSubWindows(const QList<WindowInfo> &windows, int minSize);
     QString getAtomName(xcb_atom_t atom);
     QString getWindowName(xcb_window_t window);
-    QString getWindowClass(xcb_window_t window);
-    QStringList getWindowTypes(xcb_window_t window);
-    QStringList getWindowStates(xcb_window_t window);
     WindowRect getRootWindowRect();
+
+    // Geometry of active RandR outputs in root window, cloned outputs are reported once.
+    // Return root window rect if RandR is not available.
+    QList<WindowRect> getMonitorRects();
     WindowRect getWindowRect(xcb_window_t window);
-    int getCurrentWorkspace(xcb_window_t window);
-    int getWindowWorkspace(xcb_window_t window);
+
+    // Report ConfigureNotify of window and its frame windows to this connection,
+    // return all windows that watched.
+    QList<xcb_window_t> selectConfigureEvents(xcb_window_t window);
+
+    // Keep top level window content in offscreen pixmap with Composite automatic redirection,
+    // screen is not affected, return false if Composite extension (0.2 or above) is not available.
+    bool redirectWindow(xcb_window_t window);
+    void unredirectWindow(xcb_window_t window);
+
+    // Name current pixmap of redirected window, pixmap keep old content after window resized,
+    // so name it again after resize. PixmapRect is pixmap area (include border) in root window.
+    xcb_pixmap_t nameWindowPixmap(xcb_window_t window, WindowRect &pixmapRect);
     xcb_atom_t getAtom(QString name);
     xcb_get_property_reply_t* getProperty(xcb_window_t window, QString propertyName, xcb_atom_t type);
     void setWindowBlur(int wid, QVector<uint32_t> &data);
     void translateCoords(xcb_window_t window, int32_t& x, int32_t& y);
     WindowRect adjustRectInScreenArea(WindowRect rect);
+    WindowRect adjustRectInScreenArea(WindowRect rect, const WindowRect &rootWindowRect);
+    xcb_connection_t* getConnection();
 
     xcb_window_t rootWindow;
-    
+
+signals:
+    void windowsChanged();
+
+private slots:
+    void handleWatchEvents();
+
 private:
+    struct WindowState {
+        WindowInfo info;
+        bool isValid;
+        bool isNormal;
+        bool isHidden;
+        int desktop;
+    };
+
+    int readClientList(xcb_connection_t *connection, QVector<xcb_window_t> &stacking);
+    QVector<WindowState> readWindowStates(xcb_connection_t *connection, const QVector<xcb_window_t> &windows);
+    QList<WindowInfo> buildWindowInfos(const QVector<xcb_window_t> &stacking, const QHash<xcb_window_t, WindowState> &stateTable,
+                                       int currentDesktop, const WindowRect &rootRect);
+    void watchClients(const QVector<xcb_window_t> &clients);
+    void unwatchClient(xcb_window_t client);
+    xcb_window_t getSubWindowClient(xcb_window_t parent);
+
+    QVector<xcb_atom_t> internAtoms(const QStringList &names);
+    void cacheAtom(const QString &name, xcb_atom_t atom);
+    WindowRect buildWindowRect(xcb_get_geometry_reply_t *geometry, xcb_translate_coordinates_reply_t *coordinate, xcb_get_property_reply_t *extents);
+
     xcb_connection_t* conn;
+    QHash<QString, xcb_atom_t> atoms;
+    QHash<xcb_atom_t, QString> atomNames;
+
+    xcb_connection_t* watchConn;
+    QSocketNotifier* watchNotifier;
+    xcb_window_t ignoreWindow;
+    WindowRect watchRootRect;
+    int watchCurrentDesktop;
+    QVector<xcb_window_t> watchStacking;
+    QHash<xcb_window_t, WindowState> watchStates;
+    // Watched window (client or its frame) to client.
+    QHash<xcb_window_t, xcb_window_t> watchedWindows;
+    // Sub window that select SubstructureNotify in getSubWindows to its client.
+    QHash<xcb_window_t, xcb_window_t> watchedSubWindows;
+    QList<WindowInfo> windowSnapshot;
+    QSet<xcb_window_t> changedWindows;
+    QSet<xcb_window_t> treeChangedWindows;
 };
 
 #endif